@@ -1,28 +1,15 @@
-QT += core gui \
-      xml \
-      widgets
-
-HEADERS += \
-    carriage.h \
-    char.h \
-    component.h \
-    field.h \
-    filerecord.h \
-    menu.h \
-    toolbar.h \
-    widget.h
-
-SOURCES += \
-    carriage.cpp \
-    char.cpp \
-    component.cpp \
-    field.cpp \
-    filerecord.cpp \
-    main.cpp \
-    menu.cpp \
-    toolbar.cpp \
-    widget.cpp
-
-RESOURCES += \
-    icons.qrc
-
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    core \
+    app \
+    bench \
+    replay \
+    startup \
+    tests
+
+app.depends = core
+bench.depends = core
+replay.depends = core
+startup.depends = app
+tests.depends = core
@@ -0,0 +1,317 @@
+#include "allocprofile.h"
+
+#ifdef TEXTEDITOR_ALLOC_PROFILE
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __GLIBC__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *block, size_t size);
+extern "C" void __libc_free(void *block);
+
+#define RAW_MALLOC __libc_malloc
+#define RAW_FREE __libc_free
+#else
+#define RAW_MALLOC std::malloc
+#define RAW_FREE std::free
+#endif
+
+// Everything below is reachable from operator new, so it lives in
+// zero-initialized static storage and never allocates itself.
+
+namespace {
+
+enum { SITE_CAPACITY = 1024, SITE_DEPTH = 4, SITE_SKIP = 4, REPORT_SITES = 10, NO_BUDGET = -1 };
+
+struct AllocSite
+{
+    void *frames[SITE_DEPTH];
+    qint64 count;
+    qint64 bytes;
+};
+
+struct OperationStats
+{
+    qint64 scopes;
+    qint64 count;
+    qint64 bytes;
+    qint64 worst;
+    qint64 overBudget;
+    qint64 lostSites;
+};
+
+OperationStats stats[AllocProfiler::OPERATION_COUNT + 1];
+AllocSite sites[AllocProfiler::OPERATION_COUNT][SITE_CAPACITY];
+qint64 budgets[AllocProfiler::OPERATION_COUNT];
+QBasicAtomicInt budgetsLoaded = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInt lock = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+thread_local int currentOperation = AllocProfiler::OPERATION_COUNT;
+thread_local bool inHook = false;
+thread_local qint64 allocations = 0;
+
+struct SpinLocker
+{
+    SpinLocker() { while(!lock.testAndSetAcquire(0, 1)) {} }
+    ~SpinLocker() { lock.storeRelease(0); }
+};
+
+Q_NEVER_INLINE void capture(void **frames, void *caller)
+{
+    for(int i = 0; i < SITE_DEPTH; ++i)
+        frames[i] = Q_NULLPTR;
+#ifdef __GLIBC__
+    void *buffer[SITE_SKIP + SITE_DEPTH];
+    int depth = backtrace(buffer, SITE_SKIP + SITE_DEPTH);
+    for(int i = 0; i < depth; ++i)
+        if(buffer[i] == caller){
+            std::memcpy(frames, buffer + i, qMin<int>(depth - i, SITE_DEPTH) * sizeof(void*));
+            return;
+        }
+#endif
+    frames[0] = caller;
+}
+
+void add_site(int operation, void **frames, std::size_t size)
+{
+    quintptr hash = 0;
+    for(int i = 0; i < SITE_DEPTH; ++i)
+        hash = hash * 31 + quintptr(frames[i]);
+    for(int probe = 0; probe < SITE_CAPACITY; ++probe){
+        AllocSite& site = sites[operation][(hash + probe) % SITE_CAPACITY];
+        if(!site.count)
+            std::memcpy(site.frames, frames, sizeof(site.frames));
+        else if(std::memcmp(site.frames, frames, sizeof(site.frames)))
+            continue;
+        ++site.count;
+        site.bytes += size;
+        return;
+    }
+    ++stats[operation].lostSites;
+}
+
+}
+
+const char *AllocProfiler::operationName(Operation operation)
+{
+    static const char *names[OPERATION_COUNT] = {
+        "keystroke", "paint", "paste", "font change", "load", "save"
+    };
+    return names[operation];
+}
+
+static void load_budgets()
+{
+    if(budgetsLoaded.loadAcquire())
+        return;
+    for(int i = 0; i < AllocProfiler::OPERATION_COUNT; ++i)
+        budgets[i] = NO_BUDGET;
+    // TEXTEDITOR_ALLOC_BUDGETS="keystroke=0,paint=0"
+    QStringList entries = QString::fromLocal8Bit(qgetenv("TEXTEDITOR_ALLOC_BUDGETS")).split(',');
+    foreach (const QString& entry, entries) {
+        QString name = entry.section('=', 0, 0).trimmed();
+        bool ok = false;
+        qint64 limit = entry.section('=', 1).toLongLong(&ok);
+        for(int i = 0; i < AllocProfiler::OPERATION_COUNT && ok; ++i)
+            if(name == AllocProfiler::operationName(AllocProfiler::Operation(i)))
+                budgets[i] = limit;
+    }
+    budgetsLoaded.storeRelease(1);
+}
+
+void AllocProfiler::setBudget(Operation operation, qint64 allocations)
+{
+    load_budgets();
+    budgets[operation] = allocations;
+}
+
+qint64 AllocProfiler::budget(Operation operation)
+{
+    load_budgets();
+    return budgets[operation];
+}
+
+void AllocProfiler::record(std::size_t size, void *caller)
+{
+    if(inHook)
+        return;
+    inHook = true;
+    ++allocations;
+    int operation = currentOperation;
+    void *frames[SITE_DEPTH];
+    if(operation < OPERATION_COUNT)
+        capture(frames, caller);
+    {
+        SpinLocker locker;
+        ++stats[operation].count;
+        stats[operation].bytes += size;
+        if(operation < OPERATION_COUNT)
+            add_site(operation, frames, size);
+    }
+    inHook = false;
+}
+
+int AllocProfiler::enter(Operation operation)
+{
+    load_budgets();
+    int previous = currentOperation;
+    currentOperation = operation;
+    return previous;
+}
+
+void AllocProfiler::leave(Operation operation, int previous, qint64 count)
+{
+    currentOperation = previous;
+    bool warn = false;
+    {
+        SpinLocker locker;
+        OperationStats& op = stats[operation];
+        ++op.scopes;
+        op.worst = qMax(op.worst, count);
+        if(budgets[operation] != NO_BUDGET && count > budgets[operation])
+            warn = !op.overBudget++;
+    }
+    if(warn)
+        qWarning("Allocation budget exceeded: %s made %lld allocations, budget %lld",
+                 operationName(operation), count, budgets[operation]);
+}
+
+qint64 AllocProfiler::threadAllocations()
+{
+    return allocations;
+}
+
+static QString site_name(void *address)
+{
+#ifdef __GLIBC__
+    Dl_info info;
+    if(dladdr(address, &info) && info.dli_sname){
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, Q_NULLPTR, Q_NULLPTR, &status);
+        QString name = QString::fromLatin1(status == 0 ? demangled : info.dli_sname);
+        std::free(demangled);
+        return QString("%1+0x%2").arg(name)
+                .arg(quintptr(address) - quintptr(info.dli_saddr), 0, 16);
+    }
+#endif
+    return QString("0x%1").arg(quintptr(address), 0, 16);
+}
+
+bool AllocProfiler::writeReport(const QString &fileName)
+{
+    load_budgets();
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+
+    QVector<AllocSite> top(SITE_CAPACITY);
+    for(int i = 0; i <= OPERATION_COUNT; ++i){
+        OperationStats op;
+        {
+            SpinLocker locker;
+            op = stats[i];
+            if(i < OPERATION_COUNT)
+                std::memcpy(top.data(), sites[i], sizeof(sites[i]));
+        }
+        if(i == OPERATION_COUNT){
+            out << "unscoped: " << op.count << " allocations, " << op.bytes << " bytes\n";
+            break;
+        }
+
+        Operation operation = Operation(i);
+        out << operationName(operation) << ": " << op.scopes << " operations, "
+            << op.count << " allocations, " << op.bytes << " bytes";
+        if(op.scopes)
+            out << ", " << QString::number(double(op.count) / op.scopes, 'f', 1) << " per operation, "
+                << "worst " << op.worst;
+        if(budgets[i] != NO_BUDGET)
+            out << ", budget " << budgets[i] << ", " << op.overBudget << " over";
+        if(op.lostSites)
+            out << ", " << op.lostSites << " unattributed";
+        out << '\n';
+
+        std::sort(top.begin(), top.end(), [](const AllocSite& a, const AllocSite& b) {
+            return a.count > b.count;
+        });
+        for(int s = 0; s < REPORT_SITES && top.at(s).count; ++s){
+            const AllocSite& site = top.at(s);
+            out << "  " << site.count << " allocations, " << site.bytes << " bytes\n";
+            for(int f = 0; f < SITE_DEPTH && site.frames[f]; ++f)
+                out << "      " << site_name(site.frames[f]) << '\n';
+        }
+    }
+    return true;
+}
+
+void *operator new(std::size_t size)
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    if(void *p = RAW_MALLOC(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    if(void *p = RAW_MALLOC(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    return RAW_MALLOC(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    return RAW_MALLOC(size ? size : 1);
+}
+
+void operator delete(void *block) noexcept { RAW_FREE(block); }
+void operator delete[](void *block) noexcept { RAW_FREE(block); }
+void operator delete(void *block, const std::nothrow_t&) noexcept { RAW_FREE(block); }
+void operator delete[](void *block, const std::nothrow_t&) noexcept { RAW_FREE(block); }
+void operator delete(void *block, std::size_t) noexcept { RAW_FREE(block); }
+void operator delete[](void *block, std::size_t) noexcept { RAW_FREE(block); }
+
+#ifdef __GLIBC__
+// Qt containers allocate with malloc, so glibc builds interpose it too.
+
+extern "C" void *malloc(size_t size)
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    AllocProfiler::record(count * size, __builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *block, size_t size)
+{
+    AllocProfiler::record(size, __builtin_return_address(0));
+    return __libc_realloc(block, size);
+}
+
+extern "C" void free(void *block)
+{
+    __libc_free(block);
+}
+#endif
+
+#endif
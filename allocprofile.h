@@ -0,0 +1,56 @@
+#ifndef ALLOCPROFILE_H
+#define ALLOCPROFILE_H
+
+#include <QtCore>
+
+#ifdef TEXTEDITOR_ALLOC_PROFILE
+
+class AllocProfiler
+{
+public:
+    enum Operation { Keystroke, Paint, Paste, FontChange, Load, Save, OPERATION_COUNT };
+
+    static const char *operationName(Operation operation);
+
+    static void setBudget(Operation operation, qint64 allocations);
+    static qint64 budget(Operation operation);
+    static bool writeReport(const QString& fileName);
+
+    static void record(std::size_t size, void *caller);
+    static int enter(Operation operation);
+    static void leave(Operation operation, int previous, qint64 allocations);
+    static qint64 threadAllocations();
+};
+
+class AllocScope
+{
+public:
+    explicit AllocScope(AllocProfiler::Operation operation)
+        : operation_(operation), previous_(AllocProfiler::enter(operation)),
+          begin_(AllocProfiler::threadAllocations()) {}
+    ~AllocScope()
+    {
+        AllocProfiler::leave(operation_, previous_, AllocProfiler::threadAllocations() - begin_);
+    }
+
+private:
+    AllocProfiler::Operation operation_;
+    int previous_;
+    qint64 begin_;
+
+    Q_DISABLE_COPY(AllocScope)
+};
+
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_SCOPE(operation) AllocScope ALLOC_CONCAT(allocScope_, __LINE__)(AllocProfiler::operation)
+#define ALLOC_REPORT(fileName) AllocProfiler::writeReport(fileName)
+
+#else
+
+#define ALLOC_SCOPE(operation) do {} while(0)
+#define ALLOC_REPORT(fileName) false
+
+#endif
+
+#endif
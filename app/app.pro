@@ -0,0 +1,41 @@
+QT += core gui \
+      xml \
+      widgets \
+      network
+
+TEMPLATE = app
+TARGET = TextEditor
+
+include(../corelib.pri)
+
+HEADERS += \
+    ../carriage.h \
+    ../component.h \
+    ../field.h \
+    ../findbar.h \
+    ../fontlist.h \
+    ../inputtrace.h \
+    ../instance.h \
+    ../latency.h \
+    ../menu.h \
+    ../startup.h \
+    ../toolbar.h \
+    ../widget.h
+
+SOURCES += \
+    ../carriage.cpp \
+    ../component.cpp \
+    ../field.cpp \
+    ../findbar.cpp \
+    ../fontlist.cpp \
+    ../inputtrace.cpp \
+    ../instance.cpp \
+    ../latency.cpp \
+    ../main.cpp \
+    ../menu.cpp \
+    ../startup.cpp \
+    ../toolbar.cpp \
+    ../widget.cpp
+
+RESOURCES += \
+    ../icons.qrc
@@ -0,0 +1,104 @@
+#include "arena.h"
+
+#include <cstdlib>
+
+Arena::Arena()
+{
+    for(int i = 0; i < CLASS_COUNT; ++i)
+        freeLists_[i] = Q_NULLPTR;
+    cursor_ = Q_NULLPTR;
+    end_ = Q_NULLPTR;
+    reserved_ = 0;
+    for(int i = 0; i < USAGE_COUNT; ++i)
+        used_[i] = 0;
+}
+
+Arena::~Arena()
+{
+    for(int i = 0; i < blocks_.size(); ++i)
+        ::free(blocks_[i]);
+    foreach (void *block, large_)
+        ::free(block);
+}
+
+void *Arena::allocate(int size, int &capacity, Usage usage)
+{
+    capacity = (size + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+    QMutexLocker locker(&mutex_);
+    used_[usage] += capacity;
+    if(capacity > MAX_SMALL){
+        reserved_ += capacity;
+        void *p = ::malloc(capacity);
+        large_.insert(p);
+        return p;
+    }
+
+    FreeNode *&head = freeLists_[capacity / GRANULARITY - 1];
+    if(head){
+        FreeNode *node = head;
+        head = node->next;
+        return node;
+    }
+
+    if(end_ - cursor_ < capacity){
+        char *block = static_cast<char*>(::malloc(BLOCK_SIZE));
+        blocks_.append(block);
+        reserved_ += BLOCK_SIZE;
+        cursor_ = block;
+        end_ = block + BLOCK_SIZE;
+    }
+    void *p = cursor_;
+    cursor_ += capacity;
+    return p;
+}
+
+// Once no document owns the arena its blocks are freed together by the
+// destructor, so lines that are torn down afterwards return nothing here.
+void Arena::release(void *block, int capacity, Usage usage)
+{
+    if(!block || isRetired())
+        return;
+    QMutexLocker locker(&mutex_);
+    used_[usage] -= capacity;
+    if(capacity > MAX_SMALL){
+        reserved_ -= capacity;
+        large_.remove(block);
+        ::free(block);
+        return;
+    }
+    FreeNode *node = static_cast<FreeNode*>(block);
+    FreeNode *&head = freeLists_[capacity / GRANULARITY - 1];
+    node->next = head;
+    head = node;
+}
+
+void Arena::charge(Usage usage, qint64 bytes)
+{
+    if(isRetired())
+        return;
+    QMutexLocker locker(&mutex_);
+    used_[usage] += bytes;
+}
+
+void Arena::attach()
+{
+    documents_.ref();
+}
+
+void Arena::detach()
+{
+    if(!documents_.deref())
+        retired_.store(1);
+}
+
+qint64 Arena::reserved() const
+{
+    QMutexLocker locker(&mutex_);
+    return reserved_;
+}
+
+qint64 Arena::used(Usage usage) const
+{
+    QMutexLocker locker(&mutex_);
+    return used_[usage];
+}
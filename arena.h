@@ -0,0 +1,54 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QtCore>
+
+class Arena
+{
+public:
+    enum Usage { ContentUsage, StyleUsage, LineUsage, USAGE_COUNT };
+
+    Arena();
+    ~Arena();
+
+    void *allocate(int size, int &capacity, Usage usage = ContentUsage);
+    void release(void *block, int capacity, Usage usage = ContentUsage);
+    void charge(Usage usage, qint64 bytes);
+
+    void attach();
+    void detach();
+    inline bool isRetired() const { return retired_.load() != 0; }
+
+    qint64 reserved() const;
+    qint64 used(Usage usage) const;
+
+private:
+    Q_DISABLE_COPY(Arena)
+
+    enum {
+        GRANULARITY = 16,
+        MAX_SMALL = 4096,
+        CLASS_COUNT = MAX_SMALL / GRANULARITY,
+        BLOCK_SIZE = 256 * 1024
+    };
+
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    FreeNode *freeLists_[CLASS_COUNT];
+    mutable QMutex mutex_;
+    QVector<char*> blocks_;
+    QSet<void*> large_;
+    QAtomicInt documents_;
+    QAtomicInt retired_;
+    char *cursor_;
+    char *end_;
+    qint64 reserved_;
+    qint64 used_[USAGE_COUNT];
+};
+
+typedef QSharedPointer<Arena> ArenaRef;
+
+#endif
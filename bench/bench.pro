@@ -0,0 +1,13 @@
+QT += core gui \
+      xml \
+      testlib
+
+TEMPLATE = app
+TARGET = textbench
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../corelib.pri)
+
+SOURCES += \
+    textbenchmark.cpp
@@ -0,0 +1,349 @@
+#include <QtTest>
+
+#include "char.h"
+#include "filerecord.h"
+
+class TextBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void insertSymbol_data();
+    void insertSymbol();
+    void insertErase_data();
+    void insertErase();
+    void breakJoin_data();
+    void breakJoin();
+
+    void getShiftByCoord_data();
+    void getShiftByCoord();
+    void getLineRoof_data();
+    void getLineRoof();
+
+    void fontF_data();
+    void fontF();
+
+    void copyPart_data();
+    void copyPart();
+    void cutPaste_data();
+    void cutPaste();
+    void pastePlainText_data();
+    void pastePlainText();
+
+    void load_data();
+    void load();
+    void save_data();
+    void save();
+
+private:
+    enum { LINE_LENGTH = 80 };
+
+    Text *make_text(int lines);
+    QString document(const QString& size, const QString& format);
+    static void position_rows();
+    static void file_rows();
+
+    QTemporaryDir dir_;
+    QFont font_;
+    QHash<QString, QString> files_;
+};
+
+void TextBenchmark::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    font_ = QFont("Courier", 12);
+}
+
+Text *TextBenchmark::make_text(int lines)
+{
+    Text *text = new Text;
+    int height = QFontMetrics(font_).height();
+    for(int y = 0; y < lines; ++y){
+        Line line(height, text->arena());
+        for(int x = 0; x < LINE_LENGTH; ++x)
+            line.push_back(Symbol(font_, QChar('a' + (x + y) % 26)));
+        text->push_back(line);
+    }
+    return text;
+}
+
+void TextBenchmark::position_rows()
+{
+    QTest::addColumn<int>("lines");
+    QTest::addColumn<double>("where");
+
+    const int sizes[] = { 1000, 100000 };
+    const char *names[] = { "begin", "middle", "end" };
+    const double wheres[] = { 0.0, 0.5, 1.0 };
+    for(int s = 0; s < 2; ++s)
+        for(int w = 0; w < 3; ++w)
+            QTest::newRow(qPrintable(QString("%1 lines/%2").arg(sizes[s]).arg(names[w])))
+                    << sizes[s] << wheres[w];
+}
+
+void TextBenchmark::insertSymbol_data()
+{
+    position_rows();
+}
+
+void TextBenchmark::insertSymbol()
+{
+    QFETCH(int, lines);
+    QFETCH(double, where);
+    QScopedPointer<Text> text(make_text(lines));
+    int y = int(where * (lines - 1));
+    Symbol symbol(font_, QChar('x'));
+    QBENCHMARK {
+        text->insert(LINE_LENGTH / 2, y, symbol);
+    }
+}
+
+void TextBenchmark::insertErase_data()
+{
+    position_rows();
+}
+
+void TextBenchmark::insertErase()
+{
+    QFETCH(int, lines);
+    QFETCH(double, where);
+    QScopedPointer<Text> text(make_text(lines));
+    int y = int(where * (lines - 1));
+    Symbol symbol(font_, QChar('x'));
+    QPoint pos;
+    QBENCHMARK {
+        text->insert(LINE_LENGTH / 2, y, symbol);
+        text->eraseSymbol(y, LINE_LENGTH / 2 + 1, pos);
+    }
+}
+
+void TextBenchmark::breakJoin_data()
+{
+    position_rows();
+}
+
+void TextBenchmark::breakJoin()
+{
+    QFETCH(int, lines);
+    QFETCH(double, where);
+    QScopedPointer<Text> text(make_text(lines));
+    int y = int(where * (lines - 1));
+    QBENCHMARK {
+        QPoint pos(LINE_LENGTH / 2, y);
+        text->breakLine(pos);
+        text->eraseSymbol(pos.y(), 0, pos);
+    }
+}
+
+void TextBenchmark::getShiftByCoord_data()
+{
+    position_rows();
+}
+
+void TextBenchmark::getShiftByCoord()
+{
+    QFETCH(int, lines);
+    QFETCH(double, where);
+    QScopedPointer<Text> text(make_text(lines));
+    QPoint point(LINE_LENGTH * 4, int(where * (text->height() - 1)));
+    QPoint pos;
+    QBENCHMARK {
+        text->getShiftByCoord(point, pos);
+    }
+}
+
+void TextBenchmark::getLineRoof_data()
+{
+    position_rows();
+}
+
+void TextBenchmark::getLineRoof()
+{
+    QFETCH(int, lines);
+    QFETCH(double, where);
+    QScopedPointer<Text> text(make_text(lines));
+    int y = int(where * (lines - 1));
+    QBENCHMARK {
+        text->getLineRoof(y);
+    }
+}
+
+void TextBenchmark::fontF_data()
+{
+    QTest::addColumn<int>("lines");
+    QTest::newRow("1000 lines") << 1000;
+    QTest::newRow("100000 lines") << 100000;
+}
+
+void TextBenchmark::fontF()
+{
+    QFETCH(int, lines);
+    QScopedPointer<Text> text(make_text(lines));
+    bool bold = false;
+    QBENCHMARK {
+        bold = !bold;
+        text->fontF<bool>(&QFont::setBold, QPoint(0, 0), QPoint(LINE_LENGTH, lines - 1), bold);
+    }
+}
+
+void TextBenchmark::copyPart_data()
+{
+    fontF_data();
+}
+
+void TextBenchmark::copyPart()
+{
+    QFETCH(int, lines);
+    QScopedPointer<Text> text(make_text(lines * 2));
+    QBENCHMARK {
+        TextSnapshot part = text->slice(QPoint(LINE_LENGTH / 2, lines / 2),
+                                        QPoint(LINE_LENGTH / 2, lines / 2 + lines));
+        Q_UNUSED(part);
+    }
+}
+
+void TextBenchmark::cutPaste_data()
+{
+    fontF_data();
+}
+
+void TextBenchmark::cutPaste()
+{
+    QFETCH(int, lines);
+    QScopedPointer<Text> text(make_text(lines * 2));
+    QBENCHMARK {
+        QPoint pos(LINE_LENGTH / 2, lines / 2);
+        TextSnapshot part = text->cutPart(pos, QPoint(LINE_LENGTH / 2, lines / 2 + lines));
+        text->insertPart(part, pos);
+    }
+}
+
+void TextBenchmark::file_rows()
+{
+    QTest::addColumn<QString>("size");
+    QTest::addColumn<QString>("format");
+
+    const char *sizes[] = { "1M", "100M", "1G" };
+    const char *formats[] = { "txt", "xml" };
+    for(int s = 0; s < 3; ++s)
+        for(int f = 0; f < 2; ++f)
+            QTest::newRow(qPrintable(QString("%1/%2").arg(sizes[s]).arg(formats[f])))
+                    << QString(sizes[s]) << QString(formats[f]);
+}
+
+QString TextBenchmark::document(const QString &size, const QString &format)
+{
+    QString key = size + "." + format;
+    if(files_.contains(key))
+        return files_.value(key);
+
+    QString txt = dir_.filePath(size + ".txt");
+    if(!QFile::exists(txt)){
+        qint64 bytes = size.left(size.size() - 1).toLongLong() *
+                (size.endsWith('G') ? 1024 * 1024 * 1024 : 1024 * 1024);
+        QFile file(txt);
+        if(!file.open(QIODevice::WriteOnly))
+            return QString();
+        QByteArray line(LINE_LENGTH, ' ');
+        for(qint64 written = 0, y = 0; written < bytes; written += line.size() + 1, ++y){
+            for(int x = 0; x < LINE_LENGTH; ++x)
+                line[x] = char('a' + (x + y) % 26);
+            file.write(line);
+            file.write("\n");
+        }
+    }
+
+    QString path = txt;
+    if(format == "xml"){
+        path = dir_.filePath(size + ".xml");
+        FileRecord record;
+        QScopedPointer<Text> text(record.read(txt, font_));
+        record.write(text.data(), path);
+    }
+    files_.insert(key, path);
+    return path;
+}
+
+static bool size_enabled(const QString& size)
+{
+    QString sizes = QString::fromLocal8Bit(qgetenv("TEXTEDITOR_BENCH_SIZES"));
+    if(sizes.isEmpty())
+        sizes = "1M";
+    return sizes.split(',').contains(size);
+}
+
+void TextBenchmark::pastePlainText_data()
+{
+    QTest::addColumn<QString>("size");
+    QTest::newRow("1M") << QString("1M");
+    QTest::newRow("100M") << QString("100M");
+}
+
+void TextBenchmark::pastePlainText()
+{
+    QFETCH(QString, size);
+    if(!size_enabled(size))
+        QSKIP("size not listed in TEXTEDITOR_BENCH_SIZES");
+    QFile file(document(size, "txt"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QString plain = QString::fromUtf8(file.readAll());
+    QBENCHMARK {
+        QScopedPointer<Text> text(make_text(1000));
+        TextSnapshot part = Text::fromPlainText(plain, font_, text->arena());
+        QPoint pos(LINE_LENGTH / 2, 500);
+        text->insertPart(part, pos);
+    }
+}
+
+void TextBenchmark::load_data()
+{
+    file_rows();
+}
+
+void TextBenchmark::load()
+{
+    QFETCH(QString, size);
+    QFETCH(QString, format);
+    if(!size_enabled(size))
+        QSKIP("size not listed in TEXTEDITOR_BENCH_SIZES");
+    QString path = document(size, format);
+    QVERIFY(!path.isEmpty());
+    QBENCHMARK {
+        FileRecord record;
+        QScopedPointer<Text> text(record.read(path, font_));
+    }
+}
+
+void TextBenchmark::save_data()
+{
+    file_rows();
+}
+
+void TextBenchmark::save()
+{
+    QFETCH(QString, size);
+    QFETCH(QString, format);
+    if(!size_enabled(size))
+        QSKIP("size not listed in TEXTEDITOR_BENCH_SIZES");
+    QString path = document(size, format);
+    QVERIFY(!path.isEmpty());
+    FileRecord record;
+    QScopedPointer<Text> text(record.read(path, font_));
+    QString out = dir_.filePath("out." + format);
+    QBENCHMARK {
+        QVERIFY(record.write(text.data(), out));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    TextBenchmark benchmark;
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "textbenchmark.moc"
@@ -20,7 +20,7 @@ Cursor::~Cursor()
 void Cursor::setCursor(QPoint pos, int h)
 {
     blink_ = false;
-    holder_->update();
+    holder_->update(rect_);
 
     setWidth(h);
     setHeigth(h);
@@ -28,7 +28,7 @@ void Cursor::setCursor(QPoint pos, int h)
     rect_.setRect(pos.x() + edge_.x(), pos.y() + edge_.y(), rect_.width(), rect_.height());
 
     blink_ = true;
-    holder_->update();
+    holder_->update(rect_);
 }
 
 QPoint Cursor::cursorPosition() const
@@ -52,5 +52,5 @@ void Cursor::draw(QPainter *painter, bool highlighted)
 void Cursor::updateCursor()
 {
     blink_ = !blink_;
-    holder_->update();
+    holder_->update(rect_);
 }
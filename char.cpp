@@ -1,71 +1,198 @@
 #include "char.h"
+#include "undo.h"
+#include "search.h"
+#include "highlighter.h"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const ushort *latin1_fold_table()
+{
+    struct FoldTable
+    {
+        FoldTable()
+        {
+            for(int i = 0; i < 256; ++i)
+                values[i] = QChar(static_cast<ushort>(i)).toCaseFolded().unicode();
+        }
+        ushort values[256];
+    };
+    static const FoldTable table;
+    return table.values;
+}
+
+static bool latin1_variants(ushort value, Qt::CaseSensitivity cs, uchar *variants)
+{
+    if(cs == Qt::CaseSensitive){
+        if(value > 0xFF)
+            return false;
+        variants[0] = variants[1] = static_cast<uchar>(value);
+        return true;
+    }
+    const ushort *fold = latin1_fold_table();
+    int found = 0;
+    for(int c = 0; c < 256; ++c){
+        if(fold[c] != value)
+            continue;
+        if(found == 2)
+            return false;
+        variants[found++] = static_cast<uchar>(c);
+    }
+    if(!found)
+        return false;
+    if(found == 1)
+        variants[1] = variants[0];
+    return true;
+}
+
+static inline bool latin1_equal(const uchar *data, const ushort *pattern, int n, const ushort *fold)
+{
+    if(fold){
+        for(int k = 0; k < n; ++k)
+            if(fold[data[k]] != pattern[k])
+                return false;
+        return true;
+    }
+    for(int k = 0; k < n; ++k)
+        if(data[k] != pattern[k])
+            return false;
+    return true;
+}
+
+static int find_latin1(const uchar *data, int count, int from, const ushort *pattern, int n,
+                       const uchar *first, const uchar *last, const ushort *fold)
+{
+    int end = count - n + 1;
+    int i = from;
+#ifdef __SSE2__
+    const __m128i first0 = _mm_set1_epi8(static_cast<char>(first[0]));
+    const __m128i first1 = _mm_set1_epi8(static_cast<char>(first[1]));
+    const __m128i last0 = _mm_set1_epi8(static_cast<char>(last[0]));
+    const __m128i last1 = _mm_set1_epi8(static_cast<char>(last[1]));
+    for(; i + 16 <= end; i += 16){
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1));
+        __m128i matchFirst = _mm_or_si128(_mm_cmpeq_epi8(head, first0), _mm_cmpeq_epi8(head, first1));
+        __m128i matchLast = _mm_or_si128(_mm_cmpeq_epi8(tail, last0), _mm_cmpeq_epi8(tail, last1));
+        uint mask = _mm_movemask_epi8(_mm_and_si128(matchFirst, matchLast));
+        while(mask){
+            int j = i + qCountTrailingZeroBits(mask);
+            if(latin1_equal(data + j + 1, pattern + 1, n - 2 > 0 ? n - 2 : 0, fold))
+                return j;
+            mask &= mask - 1;
+        }
+    }
+#else
+    if(first[0] == first[1]){
+        while(i < end){
+            const uchar *p = static_cast<const uchar*>(memchr(data + i, first[0], end - i));
+            if(!p)
+                return -1;
+            i = p - data;
+            if((p[n - 1] == last[0] || p[n - 1] == last[1]) && latin1_equal(p, pattern, n, fold))
+                return i;
+            ++i;
+        }
+        return -1;
+    }
+#endif
+    for(; i < end; ++i){
+        uchar head = data[i];
+        uchar tail = data[i + n - 1];
+        if((head == first[0] || head == first[1]) && (tail == last[0] || tail == last[1]) &&
+                latin1_equal(data + i, pattern, n, fold))
+            return i;
+    }
+    return -1;
+}
 
 Symbol::Symbol()
 {
-    font_ = QFont(QString("Monospace"), 14);
-    font_.setBold(false);
-    font_.setItalic(false);
+    style_ = FontTable::instance().defaultStyle();
 }
 
 Symbol::Symbol(QChar value)
 {
-    font_ = QFont(QString("Monospace"), 14);
-    font_.setBold(false);
-    font_.setItalic(false);
+    style_ = FontTable::instance().defaultStyle();
     value_ = QChar(value);
 }
 
-Symbol::Symbol(const QFont &font, QChar value)
+Symbol::Symbol(QChar value, quint16 style)
 {
-    font_ = QFont(font);
-    value_ = QChar(value);
+    style_ = style;
+    value_ = value;
 }
 
-Symbol::Symbol(const Symbol& symbol)
+Symbol::Symbol(const QFont &font, QChar value)
 {
-    font_ = symbol.font_;
-    value_ = symbol.value_;
+    style_ = FontTable::instance().intern(font);
+    value_ = QChar(value);
 }
 
-Symbol& Symbol::operator=(const Symbol& symbol)
+void Symbol::setBold(bool bold)
 {
-    font_ = symbol.font_;
-    value_ = symbol.value_;
-    return *this;
+    QFont f = font();
+    f.setBold(bold);
+    setFont(f);
 }
 
-Symbol::~Symbol()
+void Symbol::setItalic(bool italic)
 {
+    QFont f = font();
+    f.setItalic(italic);
+    setFont(f);
 }
 
 
 
-Line::Line(QObject *parent)
-    : QObject(parent)
+Line::Line(const ArenaRef& arena)
+    : arena_(arena), latin1_(arena.data())
 {
+    extra_ = Q_NULLPTR;
+    style_ = FontTable::instance().defaultStyle();
+    wide_ = false;
+    mixed_ = false;
     width_ = 0;
     height_ = 0;
 }
 
-Line::Line(int height, QObject *parent)
-    : QObject(parent)
+Line::Line(int height, const ArenaRef& arena)
+    : arena_(arena), latin1_(arena.data())
 {
+    extra_ = Q_NULLPTR;
+    style_ = FontTable::instance().defaultStyle();
+    wide_ = false;
+    mixed_ = false;
     width_ = 0;
     height_ = height;
 }
 
-Line::Line(const Line& line) :
-    QObject(line.parent())
+Line::Line(const Line& line)
+    : arena_(line.arena_), latin1_(line.latin1_)
 {
-    content_ = line.content_;
+    extra_ = line.extra_ ? new Extra(*line.extra_) : Q_NULLPTR;
+    style_ = line.style_;
+    wide_ = line.wide_;
+    mixed_ = line.mixed_;
     width_ = line.width_;
     height_ = line.height_;
 }
 
 Line& Line::operator=(const Line& line)
 {
-    setParent(line.parent());
-    content_ = line.content_;
+    if(this == &line)
+        return *this;
+    latin1_ = line.latin1_;
+    delete extra_;
+    extra_ = line.extra_ ? new Extra(*line.extra_) : Q_NULLPTR;
+    arena_ = line.arena_;
+    style_ = line.style_;
+    wide_ = line.wide_;
+    mixed_ = line.mixed_;
     width_ = line.width_;
     height_ = line.height_;
     return *this;
@@ -73,35 +200,203 @@ Line& Line::operator=(const Line& line)
 
 Line::~Line()
 {
+    delete extra_;
+}
+
+qint64 Line::memoryUsage() const
+{
+    qint64 bytes = sizeof(Line) + latin1_.capacity();
+    if(extra_)
+        bytes += sizeof(Extra) + (extra_->utf16.capacity() + extra_->styles.capacity()) * sizeof(quint16);
+    return bytes;
+}
+
+void Line::setArena(const ArenaRef& arena)
+{
+    if(arena == arena_)
+        return;
+    latin1_.setArena(arena.data());
+    if(extra_)
+        extra_->setArena(arena.data());
+    arena_ = arena;
+}
+
+bool Line::can_narrow() const
+{
+    if(!wide_)
+        return false;
+    for(int i = 0; i < extra_->utf16.size(); ++i)
+        if(extra_->utf16.at(i).unicode() > 0xFF)
+            return false;
+    return true;
+}
+
+bool Line::can_unify() const
+{
+    if(!mixed_)
+        return false;
+    for(int i = 1; i < extra_->styles.size(); ++i)
+        if(extra_->styles.at(i) != extra_->styles.at(0))
+            return false;
+    return true;
+}
+
+void Line::compact()
+{
+    if(can_narrow()){
+        for(int i = 0; i < extra_->utf16.size(); ++i)
+            latin1_.push_back(static_cast<uchar>(extra_->utf16.at(i).unicode()));
+        extra_->utf16.clear();
+        wide_ = false;
+    }
+    if(can_unify()){
+        if(!extra_->styles.isEmpty())
+            style_ = extra_->styles.at(0);
+        extra_->styles.clear();
+        mixed_ = false;
+    }
+    if(extra_ && !wide_ && !mixed_){
+        delete extra_;
+        extra_ = Q_NULLPTR;
+    }
+
+    latin1_.compact();
+    if(extra_){
+        extra_->utf16.compact();
+        extra_->styles.compact();
+    }
+}
+
+bool Line::isCompact() const
+{
+    if(can_narrow() || can_unify() || (extra_ && !wide_ && !mixed_))
+        return false;
+    return latin1_.isCompact() && (!extra_ || (extra_->utf16.isCompact() && extra_->styles.isCompact()));
+}
+
+void Line::setStyle(int pos, quint16 style)
+{
+    if(mixed_)
+        extra_->styles[pos] = style;
+    else if(style != style_){
+        if(size() == 1)
+            style_ = style;
+        else{
+            materialize_styles();
+            extra_->styles[pos] = style;
+        }
+    }
+}
+
+void Line::setStyle(int from, int to, quint16 style)
+{
+    if(!mixed_ && from <= 0 && to >= size())
+        style_ = style;
+    else
+        for(int i = from; i < to; ++i)
+            setStyle(i, style);
 }
 
-Symbol& Line::operator[](int pos)
+int Line::indexOf(const QString &needle, int from, Qt::CaseSensitivity cs) const
 {
-    return content_[pos];
+    int n = needle.size();
+    int count = size();
+    if(from < 0)
+        from = 0;
+    if(n > count - from)
+        return -1;
+    if(!n)
+        return from;
+
+    if(!wide_){
+        const ushort *fold = latin1_fold_table();
+        QVarLengthArray<ushort, 64> pattern(n);
+        for(int k = 0; k < n; ++k){
+            QChar ch = cs == Qt::CaseSensitive ? needle.at(k) : needle.at(k).toCaseFolded();
+            pattern[k] = ch.unicode();
+        }
+
+        const uchar *data = latin1_.contiguous();
+        if(data){
+            uchar first[2];
+            uchar last[2];
+            if(latin1_variants(pattern[0], cs, first) && latin1_variants(pattern[n - 1], cs, last))
+                return find_latin1(data, count, from, pattern.constData(), n, first, last,
+                                   cs == Qt::CaseSensitive ? Q_NULLPTR : fold);
+            if(cs == Qt::CaseSensitive)
+                return -1;
+        }
+
+        for(int i = from; i <= count - n; ++i){
+            int k = 0;
+            if(cs == Qt::CaseSensitive)
+                while(k < n && latin1_.at(i + k) == pattern[k])
+                    ++k;
+            else
+                while(k < n && fold[latin1_.at(i + k)] == pattern[k])
+                    ++k;
+            if(k == n)
+                return i;
+        }
+        return -1;
+    }
+
+    QChar first = cs == Qt::CaseSensitive ? needle.at(0) : needle.at(0).toCaseFolded();
+    for(int i = from; i <= count - n; ++i){
+        QChar ch = extra_->utf16.at(i);
+        if(cs == Qt::CaseSensitive ? ch != first : ch.toCaseFolded() != first)
+            continue;
+        int k = 1;
+        if(cs == Qt::CaseSensitive)
+            while(k < n && extra_->utf16.at(i + k) == needle.at(k))
+                ++k;
+        else
+            while(k < n && extra_->utf16.at(i + k).toCaseFolded() == needle.at(k).toCaseFolded())
+                ++k;
+        if(k == n)
+            return i;
+    }
+    return -1;
 }
 
+QString Line::text() const
+{
+    int count = size();
+    if(!wide_){
+        const uchar *data = latin1_.contiguous();
+        if(data || !count)
+            return QString::fromLatin1(reinterpret_cast<const char*>(data), count);
+    }
+    QString result(count, Qt::Uninitialized);
+    QChar *out = result.data();
+    for(int i = 0; i < count; ++i)
+        out[i] = valueAt(i);
+    return result;
+}
 
 qint64 Line::getSymbShift(int s) const
 {
     int width = 0;
-    if(s > content_.size())
-        s = content_.size();
-    if(s > 0)
-        for(int i = 0; i < s; ++i)
-            width += content_[i].width();
+    if(s > size())
+        s = size();
+    if(s > 0){
+        if(!wide_ && !mixed_){
+            const int *widths = FontTable::instance().latin1Widths(style_);
+            for(int i = 0; i < s; ++i)
+                width += widths[latin1_.at(i)];
+        }
+        else
+            for(int i = 0; i < s; ++i)
+                width += symbol_width(i);
+    }
     return width;
 }
 
 qint64 Line::getMaxHeight() const
 {
-    qint64 max = 0;
     if(isEmpty())
         return height_;
-    foreach (const Symbol& symb, content_) {
-        if(symb.height() > max)
-            max = symb.height();
-    }
-    return max;
+    return max_symbol_height();
 }
 
 void Line::setHeight(qint64 height) {
@@ -110,69 +405,67 @@ void Line::setHeight(qint64 height) {
 }
 
 void Line::recountHeight() {
-    int h = 0;
-    foreach (Symbol s, content_) {
-        if(s.height() > h)
-        h = s.height();
-    }
-    height_ = h;
+    height_ = isEmpty() ? 0 : max_symbol_height();
 }
 
 void Line::recountWidth() {
-    int w = 0;
-    foreach (Symbol s, content_) {
-        w += s.width();
-    }
-    width_ = w;
+    width_ = getSymbShift(size());
 }
 
 Symbol Line::pop_front()
 {
-    Symbol symb = content_.first();
-    content_.pop_front();
-    width_ -= symb.width();
-    reduce_height(symb.height());
-
-    return symb;
+    return erase(0);
 }
 
 Symbol Line::pop_back()
 {
-    Symbol symb = content_.last();
-    content_.pop_back();
-    width_ -= symb.width();
-    reduce_height(symb.height());
-
-    return symb;
+    return erase(size() - 1);
 }
 
 void Line::push_front(const Symbol& symb)
 {
-    content_.push_front(symb);
-    width_ += symb.width();
-    raise_height(symb.height());
+    insert(0, symb);
 }
 
 void Line::push_back(const Symbol& symb)
 {
-    content_.push_back(symb);
-    width_ += symb.width();
-    raise_height(symb.height());
+    insert(size(), symb);
 }
 
 void Line::insert(int pos, const Symbol& symb)
 {
-    content_.insert(content_.begin() + pos, symb);
+    if(mixed_)
+        extra_->styles.insert(pos, symb.style());
+    else if(isEmpty())
+        style_ = symb.style();
+    else if(symb.style() != style_){
+        materialize_styles();
+        extra_->styles.insert(pos, symb.style());
+    }
+
+    if(!wide_ && symb.value().unicode() > 0xFF)
+        promote();
+    if(wide_)
+        extra_->utf16.insert(pos, symb.value());
+    else
+        latin1_.insert(pos, static_cast<uchar>(symb.value().unicode()));
+
     width_ += symb.width();
     raise_height(symb.height());
 }
 
 Symbol Line::erase(int pos)
 {
-    Symbol symb = content_[pos];
+    Symbol symb = at(pos);
+    if(wide_)
+        extra_->utf16.erase(pos);
+    else
+        latin1_.erase(pos);
+    if(mixed_)
+        extra_->styles.erase(pos);
+
     width_ -= symb.width();
     int h = symb.height();
-    content_.erase(content_.begin() + pos);
     reduce_height(h);
     return symb;
 }
@@ -191,9 +484,9 @@ int Line::getSymbolBegin(int x, QPoint& pos) const
     {
         while(shift < width_)
         {
-            if(shift + content_.at(i).width() / 2 >= x)
+            if(shift + symbol_width(i) / 2 >= x)
                 break;
-            shift += content_.at(i++).width();
+            shift += symbol_width(i++);
         }
     }
     pos.setX(i);
@@ -205,19 +498,20 @@ int Line::getDifference(int s) const
 {
     if(isEmpty())
         return 0;
-    s = s == content_.size() ? s - 1 : s;
-    return content_[s].height() < height() ?
-           (height() - content_[s].height()) * 0.8 :
+    s = s == size() ? s - 1 : s;
+    int h = FontTable::instance().height(styleAt(s));
+    return h < height() ?
+           (height() - h) * 0.8 :
            0;
 }
 
 Line Line::getNewLine(int pos)
 {
-    if(content_.isEmpty())
-        return Line(height_, parent());
-    int count = content_.size() - pos;
-    qint64 height = content_[pos == content_.length() ? pos - 1 : pos].height();
-    Line newLine = Line(height, parent());
+    if(isEmpty())
+        return Line(height_, arena_);
+    int count = size() - pos;
+    qint64 height = FontTable::instance().height(styleAt(pos == size() ? pos - 1 : pos));
+    Line newLine = Line(height, arena_);
 
     while(count--)
         newLine.push_back(erase(pos));
@@ -225,16 +519,79 @@ Line Line::getNewLine(int pos)
     return newLine;
 }
 
-void Line::draw(QPainter *painter, qint64 x, qint64 y) const
+void Line::append(const QChar *values, int count, quint16 style)
+{
+    if(!count)
+        return;
+    if(mixed_)
+        for(int i = 0; i < count; ++i)
+            extra_->styles.push_back(style);
+    else if(isEmpty())
+        style_ = style;
+    else if(style != style_){
+        materialize_styles();
+        for(int i = 0; i < count; ++i)
+            extra_->styles.push_back(style);
+    }
+
+    bool wide = wide_;
+    for(int i = 0; i < count && !wide; ++i)
+        wide = values[i].unicode() > 0xFF;
+    if(wide && !wide_)
+        promote();
+    if(wide_)
+        extra_->utf16.append(values, count);
+    else{
+        QVarLengthArray<uchar, 256> latin1(count);
+        for(int i = 0; i < count; ++i)
+            latin1[i] = static_cast<uchar>(values[i].unicode());
+        latin1_.append(latin1.constData(), count);
+    }
+
+    FontTable& fonts = FontTable::instance();
+    for(int i = 0; i < count; ++i)
+        width_ += fonts.width(style, values[i]);
+    raise_height(fonts.height(style));
+}
+
+Line Line::mid(int from, int to) const
 {
-    foreach (const Symbol& symb, content_) {
-        QFont f = symb.font();
-        painter->setFont(symb.font());
+    Line part(height_, arena_);
+    for(int i = from; i < to; ++i)
+        part.push_back(at(i));
+    return part;
+}
+
+void Line::draw(QPainter *painter, qint64 x, qint64 y, const HighlightSpans &spans) const
+{
+    int current = -1;
+    QPen pen = painter->pen();
+    QRgb base = pen.color().rgb();
+    QRgb color = base;
+    int span = 0;
+    for(int i = 0; i < size(); ++i) {
+        quint16 style = styleAt(i);
+        if(style != current){
+            painter->setFont(FontTable::instance().font(style));
+            current = style;
+        }
+        if(!spans.isEmpty()){
+            while(span < spans.size() && spans.at(span).begin + spans.at(span).length <= i)
+                ++span;
+            QRgb wanted = span < spans.size() && spans.at(span).begin <= i ? spans.at(span).color : base;
+            if(wanted != color){
+                painter->setPen(QColor(wanted));
+                color = wanted;
+            }
+        }
+        QChar value = valueAt(i);
         painter->drawText(x,
                   height() * 0.8 + y,
-                  symb.value());
-        x += symb.width();
+                  value);
+        x += FontTable::instance().width(style, value);
     }
+    if(color != base)
+        painter->setPen(pen);
 }
 
 void Line::raise_height(int h)
@@ -247,14 +604,9 @@ void Line::raise_height(int h)
 
 void Line::reduce_height(int h)
 {
-    int heighest = isEmpty() ? height_ : 0;
     if(h == height_)
     {
-        foreach(Symbol symb, content_)
-        {
-            if(symb.height() > heighest)
-                heighest = symb.height();
-        }
+        int heighest = isEmpty() ? height_ : max_symbol_height();
         if(heighest < height_)
         {
             height_ = heighest;
@@ -262,170 +614,466 @@ void Line::reduce_height(int h)
     }
 }
 
+int Line::max_symbol_height() const
+{
+    if(!mixed_)
+        return FontTable::instance().height(style_);
+    int max = 0;
+    for(int i = 0; i < extra_->styles.size(); ++i) {
+        int h = FontTable::instance().height(extra_->styles.at(i));
+        if(h > max)
+            max = h;
+    }
+    return max;
+}
 
+int Line::symbol_width(int pos) const
+{
+    return FontTable::instance().width(styleAt(pos), valueAt(pos));
+}
+
+void Line::ensure_extra()
+{
+    if(!extra_)
+        extra_ = new Extra(arena_.data());
+}
+
+void Line::promote()
+{
+    ensure_extra();
+    for(int i = 0; i < latin1_.size(); ++i)
+        extra_->utf16.push_back(QChar(static_cast<ushort>(latin1_.at(i))));
+    latin1_.clear();
+    wide_ = true;
+}
+
+void Line::materialize_styles()
+{
+    ensure_extra();
+    for(int i = 0; i < size(); ++i)
+        extra_->styles.push_back(style_);
+    mixed_ = true;
+}
+
+
+
+static quint64 next_document_version()
+{
+    static QAtomicInt documents;
+    return static_cast<quint64>(documents.fetchAndAddRelaxed(1) + 1) << 32;
+}
 
 Text::Text(QObject *parent)
-    : QObject(parent)
+    : QObject(parent), arena_(new Arena)
 {
+    arena_->attach();
     height_ = 0;
+    activeLine_ = -1;
+    version_ = next_document_version();
+    undo_ = Q_NULLPTR;
+    recording_ = false;
+    roofsValid_ = 0;
 }
 
 Text::Text(int h, QObject *parent)
-    : QObject(parent)
+    : QObject(parent), arena_(new Arena)
 {
-    Line line = Line(h, this);
+    arena_->attach();
+    Line line = Line(h, arena_);
     height_ = 0;
+    activeLine_ = -1;
+    version_ = next_document_version();
+    undo_ = Q_NULLPTR;
+    recording_ = false;
+    roofsValid_ = 0;
     insert(0, line);
 }
 
+// Builds lines straight into another document's arena, so a file read in
+// chunks ends up in the arena of the document it is appended to.
+Text::Text(const ArenaRef& arena, QObject *parent)
+    : QObject(parent), arena_(arena ? arena : ArenaRef(new Arena))
+{
+    arena_->attach();
+    height_ = 0;
+    activeLine_ = -1;
+    version_ = next_document_version();
+    undo_ = Q_NULLPTR;
+    recording_ = false;
+    roofsValid_ = 0;
+}
+
 Text::Text(const Text& text) :
-    QObject(text.parent())
+    QObject(text.parent()), arena_(text.arena_)
 {
+    arena_->attach();
     setParent(text.parent());
     content_ = text.content_;
     height_ = text.height_;
+    activeLine_ = -1;
+    version_ = text.version_;
+    undo_ = Q_NULLPTR;
+    recording_ = false;
+    roofsValid_ = 0;
 }
 
+// The last document to let go of the arena retires it first, so the history
+// and the lines below skip their per-buffer releases and the blocks are freed
+// in one go once nothing references them.
 Text::~Text()
 {
+    arena_->detach();
+    delete undo_;
 }
 
 Text& Text::operator=(const Text& text)
 {
+    int removed = content_.size();
     setParent(text.parent());
     content_ = text.content_;
+    if(arena_ != text.arena_){
+        text.arena_->attach();
+        arena_->detach();
+        arena_ = text.arena_;
+    }
     height_ = text.height_;
+    activeLine_ = -1;
+    ++version_;
+    if(undo_)
+        undo_->clear();
+    lines_changed(0, removed, content_.size());
     return *this;
 }
 
-Line& Text::operator[](int pos)
+// Deep copy whose lines live in the given arena instead of the document's.
+TextSnapshot TextSnapshot::copy(const ArenaRef& arena) const
 {
-    return content_[pos];
+    TextSnapshot copied;
+    copied.lines_.reserve(lines_.size());
+    for(int i = 0; i < lines_.size(); ++i){
+        LineNode *node = new LineNode(lines_.at(i)->line);
+        node->line.setArena(arena);
+        copied.lines_.append(LineRef(node));
+    }
+    copied.version_ = version_;
+    copied.height_ = height_;
+    return copied;
+}
+
+TextSnapshot Text::snapshot() const
+{
+    TextSnapshot snapshot;
+    snapshot.lines_ = content_;
+    snapshot.version_ = version_;
+    snapshot.height_ = height_;
+    return snapshot;
+}
+
+void Text::setActiveLine(int l)
+{
+    if(l == activeLine_)
+        return;
+    // Only detach the line when compacting changes it, so leaving a line that
+    // is shared with a snapshot or the history does not copy it.
+    if(activeLine_ >= 0 && activeLine_ < content_.size() && !at(activeLine_).isCompact())
+        line_ref(activeLine_).compact();
+    activeLine_ = l;
+}
+
+
+void Text::setUndoEnabled(bool enabled)
+{
+    if(enabled && !undo_)
+        undo_ = new UndoStack;
+    else if(!enabled){
+        delete undo_;
+        undo_ = Q_NULLPTR;
+    }
 }
 
+bool Text::undo(QPoint &pos)
+{
+    EditCommand command;
+    if(!undo_ || !undo_->takeUndo(command))
+        return false;
+    undo_->pushRedo(replay(command));
+    pos = command.before;
+    return true;
+}
+
+bool Text::redo(QPoint &pos)
+{
+    EditCommand command;
+    if(!undo_ || !undo_->takeRedo(command))
+        return false;
+    undo_->pushUndo(replay(command));
+    pos = command.after;
+    return true;
+}
+
+void Text::memoryUsage(MemoryUsage &usage) const
+{
+    qint64 content = arena_->used(Arena::ContentUsage);
+    qint64 styles = arena_->used(Arena::StyleUsage);
+    usage.add(MemoryUsage::Content, content);
+    usage.add(MemoryUsage::Styles, styles);
+    usage.add(MemoryUsage::Lines, arena_->used(Arena::LineUsage) +
+              content_.capacity() * qint64(sizeof(LineRef)) + content_.size() * qint64(sizeof(LineNode)));
+    usage.add(MemoryUsage::Slack, qMax<qint64>(arena_->reserved() - content - styles, 0));
+    usage.add(MemoryUsage::Metrics, roofs_.capacity() * qint64(sizeof(qint64)));
+}
 
 qint64 Text::width() const
 {
     int widthest = 0;
-    foreach (const Line& l, content_) {
-        if(l.getWidth() > widthest)
-            widthest = l.getWidth();
+    for(int i = 0; i < content_.size(); ++i) {
+        if(line_ref(i).getWidth() > widthest)
+            widthest = line_ref(i).getWidth();
     }
     return widthest;
 }
 
-void Text::recountHeight() {
-    int h = 0;
-    foreach (Line l, content_) {
-        h += l.height();
+int Text::lineAt(qint64 y) const
+{
+    extend_roofs(content_.size(), y);
+    QVector<qint64>::const_iterator it =
+            std::upper_bound(roofs_.constBegin(), roofs_.constBegin() + roofsValid_, y);
+    return qBound(0, int(it - roofs_.constBegin()) - 1, content_.size() - 1);
+}
+
+void Text::extend_roofs(int line, qint64 y) const
+{
+    if(roofs_.size() != content_.size() + 1){
+        roofs_.resize(content_.size() + 1);
+        roofsValid_ = qMin(roofsValid_, roofs_.size());
+    }
+    if(!roofsValid_){
+        roofs_[0] = 0;
+        roofsValid_ = 1;
     }
+    while(roofsValid_ <= line && roofs_.at(roofsValid_ - 1) <= y){
+        roofs_[roofsValid_] = roofs_.at(roofsValid_ - 1) + line_ref(roofsValid_ - 1).height();
+        ++roofsValid_;
+    }
+}
+
+void Text::recountHeight() {
+    qint64 h = 0;
+    for(int i = 0; i < content_.size(); ++i)
+        h += content_.at(i)->line.height();
     height_ = h;
 }
 
 Line Text::erase(int pos)
 {
-    reduce_height(content_[pos].height());
-    Line line = content_[pos];
+    bool record = begin_record();
+    LineList removed;
+    if(record)
+        removed.append(content_.at(pos));
+    const Line line = at(pos);
+    reduce_height(line.height());
     content_.erase(content_.begin() + pos);
+    ++version_;
+    lines_changed(pos, 1, 0);
+    if(record)
+        end_record_lines(pos, 0, removed, QPoint(0, pos), QPoint(0, pos));
     return line;
 }
 
 void Text::insert(int pos, const Line& line)
 {
-    content_.insert(content_.begin() + pos, line);
+    bool record = begin_record();
+    content_.insert(content_.begin() + pos, LineRef(new LineNode(line)));
+    adopt(line_ref(pos));
     raise_height(line.height());
+    ++version_;
+    lines_changed(pos, 0, 1);
+    if(record)
+        end_record_lines(pos, 1, LineList(), QPoint(0, pos), QPoint(0, pos));
 }
 
 void Text::insert(int posX, int posY, const Symbol &symb)
 {
-    int h = symb.height() - content_[posY].height();
-    content_[posY].insert(posX, symb);
+    ++version_;
+    bool record = begin_record();
+    int h = symb.height() - line_ref(posY).height();
+    line_ref(posY).insert(posX, symb);
     if(h > 0)
         raise_height(h);
+    lines_changed(posY, 1, 1);
+    if(record)
+        end_record(EditDelta(EditDelta::RemoveSymbols, posX, posY, 1),
+                   QPoint(posX, posY), QPoint(posX + 1, posY));
     return ;
 }
 
-Line& Text::pop_front()
+Line Text::pop_front()
 {
-    Line& line = content_.first();
-    content_.pop_front();
-    reduce_height(line.height());
-    return line;
+    return erase(0);
 }
 
-Line& Text::pop_back()
+Line Text::pop_back()
 {
-    Line& line = content_.last();
-    content_.pop_back();
-    reduce_height(line.height());
-    return line;
+    return erase(length() - 1);
 }
 
 void Text::push_front(const Line &line)
 {
-    content_.push_front(line);
-    raise_height(line.height());
+    insert(0, line);
 }
 
 void Text::push_back(const Line &line)
 {
-    content_.push_back(line);
-    raise_height(line.height());
+    insert(length(), line);
 }
 
 Symbol Text::getSymbol(int i, int j)
 {
     if(i < 0) i = 0;
     else if(i >= content_.length()) i = content_.length() - 1;
-    if(content_[i].isEmpty())
+    if(line_ref(i).isEmpty())
         return Symbol();
     if(j < 0) j = 0;
-    else if(j >= content_[i].length()) j = content_[i].length() - 1;
+    else if(j >= line_ref(i).length()) j = line_ref(i).length() - 1;
 
-    return content_[i][j];
+    return line_ref(i)[j];
 }
 
 void Text::eraseSymbol(int l, int s, QPoint& pos)
 {
+    ++version_;
+    bool record = begin_record();
     if(!s && l){
-        int _p = content_[l - 1].size();
-        for(int i = 0; i < content_[l].length(); ++i)
-            content_[l - 1].push_back(content_[l][i]);
-        reduce_height(content_[l].height());
+        int _p = line_ref(l - 1).size();
+        for(int i = 0; i < line_ref(l).length(); ++i)
+            line_ref(l - 1).push_back(at(l)[i]);
+        reduce_height(line_ref(l).height());
         content_.erase(content_.begin() + l);
         pos = QPoint(_p, l - 1);
+        lines_changed(l - 1, 2, 1);
+        if(record)
+            end_record(EditDelta(EditDelta::SplitLine, _p, l - 1), QPoint(0, l), pos);
         }
     else if(s){
-        int h = content_[l].height();
-        content_[l].erase(s - 1);
-        if(!content_[l].isEmpty()){
-            reduce_height(h - content_[l].getMaxHeight());
+        int h = line_ref(l).height();
+        EditDelta inverse(EditDelta::InsertSymbols, s - 1, l);
+        inverse.symbols.append(line_ref(l).erase(s - 1));
+        lines_changed(l, 1, 1);
+        if(!line_ref(l).isEmpty()){
+            reduce_height(h - line_ref(l).getMaxHeight());
         pos = QPoint(s - 1, l);
         }
+        if(record)
+            end_record(inverse, QPoint(s, l), QPoint(s - 1, l));
     }
+    else if(record)
+        end_record();
 }
 
 void Text::deleteText(const QPoint &begin, const QPoint &end)
 {
+    ++version_;
+    bool record = begin_record();
+    EditDelta inverse(EditDelta::ReplaceLines, 0, begin.y(), 1);
+    if(record && begin.y() < end.y())
+        inverse.lines = content_.mid(begin.y(), end.y() - begin.y() + 1);
+    else if(record){
+        inverse = EditDelta(EditDelta::InsertSymbols, begin.x(), begin.y());
+        for(int j = begin.x(); j < end.x(); ++j)
+            inverse.symbols.append(at(begin.y())[j]);
+    }
+
     if(begin.y() < end.y())
     {
-        int i = begin.y();
-        content_[i].getNewLine(begin.x());
-        for(i++; i < end.y(); ++i){
-            erase(begin.y() + 1);
-        }
+        line_ref(begin.y()).getNewLine(begin.x());
         for(int j = 0; j < end.x(); ++j)
-            content_[begin.y() + 1].erase(0);
-
-        while(content_[begin.y() + 1].length())
-            content_[begin.y()].push_back(content_[begin.y() + 1].erase(0));
-        erase(begin.y() + 1);
+            line_ref(end.y()).erase(0);
+        while(line_ref(end.y()).length())
+            line_ref(begin.y()).push_back(line_ref(end.y()).erase(0));
+
+        // The lines in between go in one removal and one notification, so
+        // observers do not pay for every line of a large deletion.
+        int count = end.y() - begin.y();
+        for(int i = begin.y() + 1; i <= end.y(); ++i)
+            reduce_height(content_.at(i)->line.height());
+        content_.remove(begin.y() + 1, count);
+        lines_changed(begin.y(), count + 1, 1);
     }
     else
     {
         for(int j = begin.x(); j < end.x(); ++j)
-            content_[begin.y()].erase(begin.x());
+            line_ref(begin.y()).erase(begin.x());
+        lines_changed(begin.y(), 1, 1);
     }
+    if(record)
+        end_record(inverse, end, begin);
+}
+
+int Text::replace(const QVector<SearchMatch> &matches, const QString &text)
+{
+    bool record = begin_record();
+    EditDelta inverse(EditDelta::SwapLines, 0, 0);
+    int replaced = 0;
+    int i = 0;
+    while(i < matches.size()){
+        int y = matches.at(i).line;
+        if(y < 0 || y >= content_.size()){
+            ++i;
+            continue;
+        }
+        const Line& old = at(y);
+        Line line(0, arena_);
+        int copied = 0;
+        for(; i < matches.size() && matches.at(i).line == y; ++i){
+            const SearchMatch& match = matches.at(i);
+            if(match.column < copied || match.column + match.length > old.size())
+                continue;
+            for(; copied < match.column; ++copied)
+                line.push_back(old.at(copied));
+            quint16 style = old.styleAt(match.column);
+            for(int k = 0; k < text.size(); ++k)
+                line.push_back(Symbol(text.at(k), style));
+            copied += match.length;
+            ++replaced;
+        }
+        if(!copied)
+            continue;
+        for(; copied < old.size(); ++copied)
+            line.push_back(old.at(copied));
+        if(line.isEmpty())
+            line = Line(old.height(), arena_);
+        line.compact();
+
+        height_ += line.height() - old.height();
+        LineRef ref(new LineNode(line));
+        if(record){
+            inverse.rows.append(y);
+            inverse.lines.append(content_.at(y));
+        }
+        content_[y] = ref;
+        lines_changed(y, 1, 1);
+    }
+    if(!replaced){
+        if(record)
+            end_record();
+        return 0;
+    }
+
+    ++version_;
+    if(record)
+        end_record(inverse, matches.first().begin(), matches.first().begin());
+    return replaced;
+}
+
+void Text::breakLine(QPoint &pos)
+{
+    bool record = begin_record();
+    Line line = line_ref(pos.y()).getNewLine(pos.x());
+    lines_changed(pos.y(), 1, 1);
+    insert(pos.y() + 1, line);
+    if(record)
+        end_record(EditDelta(EditDelta::JoinLine, pos.x(), pos.y()), pos, QPoint(0, pos.y() + 1));
+    pos = QPoint(0, pos.y() + 1);
 }
 
 int Text::getLineShift(int l , int s) const
@@ -434,52 +1082,44 @@ int Text::getLineShift(int l , int s) const
     if(s <= 0)
         s = 0;
     else
-        s = s >= content_[l].size() ? content_[l].size() - 1 : s;
-    Y += l > 0 ? content_[l].getDifference(s) : content_[0].getDifference(s);
+        s = s >= line_ref(l).size() ? line_ref(l).size() - 1 : s;
+    Y += l > 0 ? line_ref(l).getDifference(s) : line_ref(0).getDifference(s);
     return Y;
 }
 
 int Text::getLineRoof(int l) const
 {
-    int Y = 0;
     if(l >= content_.size())
         l = content_.size() - 1;
-    if(l >= 0)
-    {
-        LineList::const_iterator it = content_.begin();
-        for(; it != content_.begin() + l; ++ it)
-            Y += it->height();
-    }
-    return Y;
+    if(l <= 0)
+        return 0;
+    extend_roofs(l, std::numeric_limits<qint64>::max());
+    return roofs_.at(l);
 }
 
 QPoint Text::getShiftByCoord(QPoint point, QPoint& pos) const
 {
+    TRACE_SCOPE("Text::getShiftByCoord");
     qint64 shiftY = 0;
     qint64 shiftX = 0;
     qint64 i = 0;
     if(point.y() >=  height_)
     {
-        shiftX = content_.last().getWidth();
-        shiftY = height_ - content_.last().height();
-        pos.setX(content_[content_.size() - 1].size());
+        shiftX = line_ref(length() - 1).getWidth();
+        shiftY = height_ - line_ref(length() - 1).height();
+        pos.setX(line_ref(content_.size() - 1).size());
         pos.setY(content_.size() - 1);
     }
     else
     {
-        if(point.y() <= 0)
-            shiftY = 0;
-        else
-            while(shiftY < height_)
-            {
-                if(shiftY + content_.at(i).height() > point.y())
-                    break;
-                    shiftY += content_.at(i++).height();
-            }
-        shiftX = content_.at(i).getSymbolBegin(point.x(), pos);
+        if(point.y() > 0){
+            i = lineAt(point.y());
+            shiftY = getLineRoof(i);
+        }
+        shiftX = line_ref(i).getSymbolBegin(point.x(), pos);
         pos.setY(i);
     }
-    shiftY += content_[pos.y()].getDifference(pos.x());
+    shiftY += line_ref(pos.y()).getDifference(pos.x());
     return QPoint(shiftX, shiftY);
 }
 
@@ -494,30 +1134,30 @@ QPoint Text::getShiftByPos(int x, int y, QPoint& pos) const
         y = content_.size() - 1;
     if(x < 0){
         if(y > 0){
-            x = content_[y - 1].size();
-            X = content_[y - 1].getSymbShift(content_[y - 1].length());
+            x = line_ref(y - 1).size();
+            X = line_ref(y - 1).getSymbShift(line_ref(y - 1).length());
             y = y - 1;
-            Y = getLineShift(y, content_[y].length());
+            Y = getLineShift(y, line_ref(y).length());
         }
         else{
             x = 0;
-            Y += content_[y].getDifference(0);
+            Y += line_ref(y).getDifference(0);
         }
     }
-    else if(x > content_[y].size()){
+    else if(x > line_ref(y).size()){
         if(y < content_.size() - 1){
             x = 0;
-            X = content_[++y].getSymbShift(0);
+            X = line_ref(++y).getSymbShift(0);
             Y = getLineShift(y, x);
         }
         else{
             x--;
-            X = content_[y].getWidth();
+            X = line_ref(y).getWidth();
             Y = getLineShift(y, x);
         }
     }
     else{
-        X = content_[y].getSymbShift(x);
+        X = line_ref(y).getSymbShift(x);
         Y = getLineShift(y, x);
     }
     pos.setX(x);
@@ -525,108 +1165,285 @@ QPoint Text::getShiftByPos(int x, int y, QPoint& pos) const
     return QPoint(X, Y);
 }
 
-qint64 Text::draw(QPainter *painter, QPoint curPos, QPoint edge) const
+qint64 Text::draw(QPainter *painter, QPoint curPos, QPoint edge, const Highlighter *highlighter,
+                  int first, int last) const
 {
+    TRACE_SCOPE("Text::draw");
+    if(last < 0 || last >= content_.size())
+        last = content_.size() - 1;
+    first = qBound(0, first, last);
     qint64 x = edge.x();
-    qint64 y = edge.y();
+    qint64 y = edge.y() + getLineRoof(first);
     int widthest = 0;
-    foreach(const Line& line, content_) {
+    for(int i = first; i <= last; ++i) {
+        const Line& line = line_ref(i);
         if(line.getWidth() > widthest)
             widthest = line.getWidth();
-        line.draw(painter, x, y);
+        if(highlighter)
+            line.draw(painter, x, y, highlighter->spans(i));
+        else
+            line.draw(painter, x, y);
         x = edge.x();
         y += line.height();
     }
     return widthest;
 }
 
-void Text::copyPart(Text* res, QPoint beginPos, QPoint endPos)
+TextSnapshot Text::slice(QPoint beginPos, QPoint endPos) const
 {
-    if(res != Q_NULLPTR)
-        delete res;
+    TextSnapshot part;
+    part.version_ = version_;
+    if(beginPos.y() == endPos.y()){
+        part.lines_.append(LineRef(new LineNode(at(beginPos.y()).mid(beginPos.x(), endPos.x()))));
+        part.height_ = part.lines_.first()->line.height();
+        return part;
+    }
 
-    res = new Text(parent());
-    Line line(this);
-    if(beginPos.y() < endPos.y())
-    {
-        if(content_[beginPos.y()].isEmpty() && beginPos.y() < endPos.y())
-            res->push_back(Line(content_[beginPos.y()].height(), this));
-        else{
-            for(int j = beginPos.x(); j < content_[beginPos.y()].size(); ++j)
-                line.push_back(Symbol(content_[beginPos.y()][j]));
-            res->push_back(line);
-        }
+    bool wholeFirst = !beginPos.x();
+    bool wholeLast = endPos.x() >= at(endPos.y()).size();
+    int first = wholeFirst ? beginPos.y() : beginPos.y() + 1;
+    int last = wholeLast ? endPos.y() : endPos.y() - 1;
+    part.lines_ = content_.mid(first, last - first + 1);
+    if(!wholeFirst)
+        part.lines_.prepend(LineRef(new LineNode(at(beginPos.y()).mid(beginPos.x(), at(beginPos.y()).size()))));
+    if(!wholeLast)
+        part.lines_.append(LineRef(new LineNode(at(endPos.y()).mid(0, endPos.x()))));
+
+    if(part.lines_.size() == content_.size())
+        part.height_ = height_;
+    else
+        for(int i = 0; i < part.lines_.size(); ++i)
+            part.height_ += part.lines_.at(i)->line.height();
+    return part;
+}
+
+TextSnapshot Text::cutPart(QPoint beginPos, QPoint endPos)
+{
+    TextSnapshot part = slice(beginPos, endPos);
+    deleteText(beginPos, endPos);
+    return part;
+}
+
+void Text::insertPart(const TextSnapshot& source, QPoint& pos)
+{
+    if(source.isNull())
+        return;
+    ++version_;
+    bool record = begin_record();
+    QPoint begin = pos;
+    LineList before;
+    if(record)
+        before.append(content_.at(pos.y()));
+
+    int count = source.length();
+    Line& current = line_ref(pos.y());
+    qint64 h = current.height();
+    const Line& head = source.at(0);
+    if(count == 1){
+        for(int j = 0; j < head.length(); ++j)
+            current.insert(pos.x() + j, head.at(j));
+        height_ += current.height() - h;
+        pos.setX(pos.x() + head.length());
+        lines_changed(begin.y(), 1, 1);
+        if(record)
+            end_record(EditDelta(EditDelta::RemoveSymbols, begin.x(), begin.y(), head.length()),
+                       begin, pos);
+        return;
+    }
 
-        for(int i = beginPos.y() + 1; i < endPos.y(); ++i)
-            res->push_back(Line(content_[i]));
+    Line tail = current.getNewLine(pos.x());
+    for(int j = 0; j < head.length(); ++j)
+        current.push_back(head.at(j));
+    height_ += current.height() - h;
 
-        line = Line(this);
-        for(int j = 0; j < endPos.x(); ++j)
-            line.push_back(Symbol(content_[endPos.y()][j]));
-        if(!line.isEmpty())
-            res->push_back(line);
+    content_.insert(pos.y() + 1, count - 1, LineRef());
+    for(int j = 1; j < count - 1; ++j){
+        content_[pos.y() + j] = source.lines_.at(j);
+        height_ += source.at(j).height();
     }
-    else if(beginPos.y() == endPos.y()){
-        for(int j = beginPos.x(); j < endPos.x(); ++j)
-            line.push_back(Symbol(content_[beginPos.y()][j]));
-        res->push_back(line);
+    const Line& last = source.at(count - 1);
+    int y = pos.y() + count - 1;
+    if(tail.isEmpty())
+        content_[y] = source.lines_.at(count - 1);
+    else{
+        Line joined(last);
+        for(int j = 0; j < tail.length(); ++j)
+            joined.push_back(tail.at(j));
+        content_[y] = LineRef(new LineNode(joined));
+        adopt(line_ref(y));
     }
+    height_ += at(y).height();
+
+    pos = QPoint(last.length(), y);
+    lines_changed(begin.y(), 1, count);
+    if(record)
+        end_record_lines(begin.y(), count, before, begin, pos);
 }
 
-void Text::cutPart(Text* res, QPoint beginPos, QPoint endPos)
+// Appends the lines of a document that is still being read; not an edit, so
+// nothing is recorded for undo.
+void Text::appendLines(const TextSnapshot& source)
 {
-    if(res != Q_NULLPTR)
-        delete res;
-
-    res = new Text(parent());
-    Line line(this);
-    if(beginPos.y() < endPos.y())
-    {
-        int secondPos = beginPos.y() + 1;
-        res->push_back(content_[beginPos.y()].getNewLine(beginPos.x()));
+    if(source.isNull())
+        return;
+    ++version_;
+    int begin = content_.length();
+    content_ += source.lines_;
+    height_ += source.height();
+    lines_changed(begin, 0, source.length());
+}
 
-        for(int i = secondPos; i < endPos.y(); ++i)
-            res->push_back(erase(secondPos));
+TextSnapshot Text::fromPlainText(const QString& text, const QFont& font, const ArenaRef& arena)
+{
+    TRACE_SCOPE("Text::fromPlainText");
+    const QChar *data = text.constData();
+    QVector<int> starts;
+    starts.append(0);
+    for(int i = 0; i < text.size(); ++i)
+        if(data[i] == '\n')
+            starts.append(i + 1);
+    starts.append(text.size() + 1);
+
+    ArenaRef target = arena ? arena : ArenaRef(new Arena);
+    int height = QFontMetrics(font).height();
+    quint16 style = FontTable::instance().intern(font);
+    TextSnapshot part;
+    part.version_ = next_document_version();
+    part.lines_.resize(starts.size() - 1);
+    LineRef *lines = part.lines_.data();
+    JobPool::instance().parallelFor(JobPool::Interactive, part.lines_.size(), PASTE_GRAIN,
+                                    [&](int from, int to) {
+        for(int i = from; i < to; ++i){
+            int begin = starts.at(i);
+            int end = starts.at(i + 1) - 1;
+            if(end > begin && data[end - 1] == '\r')
+                --end;
+            Line line(height, target);
+            line.append(data + begin, end - begin, style);
+            lines[i] = LineRef(new LineNode(line));
+        }
+    });
+    for(int i = 0; i < part.lines_.size(); ++i)
+        part.height_ += lines[i]->line.height();
+    return part;
+}
 
-        line = Line(this);
-        for(int j = 0; j < endPos.x(); ++j)
-            line.push_back(content_[secondPos].erase(0));
-        if(!line.isEmpty())
-            res->push_back(line);
+bool Text::begin_record()
+{
+    if(!undo_ || recording_)
+        return false;
+    recording_ = true;
+    return true;
+}
 
-        for(int j = 0; j < content_[secondPos].size(); ++j)
-            content_[beginPos.y()].push_back(content_[secondPos][j]);
-        erase(secondPos);
-    }
-    else if(beginPos.y() == endPos.y()){
-        for(int j = beginPos.x(); j < endPos.x(); ++j)
-            line.push_back(content_[beginPos.y()].erase(beginPos.x()));
-        res->push_back(line);
-    }
+void Text::end_record()
+{
+    recording_ = false;
 }
 
-void Text::insertPart(Text* source, QPoint& pos)
+void Text::end_record(const EditDelta &inverse, QPoint before, QPoint after)
 {
-    Line line = content_[pos.y()].getNewLine(pos.x());
-    if((*source)[0].isEmpty() && (*source)[source->length() - 1].isEmpty()){
-        insert(pos.y(), (*source)[0]);
-        pos.setY(pos.y() + 1);
-    }
-    else
-        for(int j = 0; j < (*source)[0].length(); ++j)
-            content_[pos.y()].push_back(Symbol((*source)[0][j]));
+    recording_ = false;
+    undo_->record(inverse, before, after);
+}
 
-    for(int j = 1; j < source->length(); ++j)
-        insert(pos.y() + j, Line((*source)[j]));
+void Text::end_record_lines(int y, int count, const LineList &lines, QPoint before, QPoint after)
+{
+    EditDelta inverse(EditDelta::ReplaceLines, 0, y, count);
+    inverse.lines = lines;
+    end_record(inverse, before, after);
+}
 
-    for(int j = 0; j < line.length(); ++j)
-        content_[pos.y() + source->length() - 1].push_back(Symbol(line[j]));
-    pos.setY(pos.y() + source->length() - 1);
+EditDelta Text::apply_delta(const EditDelta &delta)
+{
+    EditDelta inverse;
+    switch(delta.kind){
+    case EditDelta::InsertSymbols:{
+        Line& line = line_ref(delta.y);
+        qint64 h = line.height();
+        for(int i = 0; i < delta.symbols.size(); ++i)
+            line.insert(delta.x + i, delta.symbols.at(i));
+        height_ += line.height() - h;
+        lines_changed(delta.y, 1, 1);
+        inverse = EditDelta(EditDelta::RemoveSymbols, delta.x, delta.y, delta.symbols.size());
+        break;
+    }
+    case EditDelta::RemoveSymbols:{
+        Line& line = line_ref(delta.y);
+        qint64 h = line.height();
+        inverse = EditDelta(EditDelta::InsertSymbols, delta.x, delta.y);
+        inverse.symbols.reserve(delta.count);
+        for(int i = 0; i < delta.count; ++i)
+            inverse.symbols.append(line.erase(delta.x));
+        height_ += line.height() - h;
+        lines_changed(delta.y, 1, 1);
+        break;
+    }
+    case EditDelta::SplitLine:{
+        Line& line = line_ref(delta.y);
+        qint64 h = line.height();
+        Line tail = line.getNewLine(delta.x);
+        height_ += line.height() - h;
+        lines_changed(delta.y, 1, 1);
+        insert(delta.y + 1, tail);
+        inverse = EditDelta(EditDelta::JoinLine, delta.x, delta.y);
+        break;
+    }
+    case EditDelta::JoinLine:{
+        Line& line = line_ref(delta.y);
+        qint64 h = line.height();
+        int x = line.size();
+        const Line& next = at(delta.y + 1);
+        for(int j = 0; j < next.size(); ++j)
+            line.push_back(next.at(j));
+        height_ += line.height() - h;
+        lines_changed(delta.y, 1, 1);
+        erase(delta.y + 1);
+        inverse = EditDelta(EditDelta::SplitLine, x, delta.y);
+        break;
+    }
+    case EditDelta::SwapLines:{
+        inverse = EditDelta(EditDelta::SwapLines, 0, 0);
+        inverse.rows = delta.rows;
+        inverse.lines.reserve(delta.rows.size());
+        for(int i = 0; i < delta.rows.size(); ++i){
+            int y = delta.rows.at(i);
+            inverse.lines.append(content_.at(y));
+            height_ += delta.lines.at(i)->line.height() - content_.at(y)->line.height();
+            content_[y] = delta.lines.at(i);
+            lines_changed(y, 1, 1);
+        }
+        break;
+    }
+    case EditDelta::ReplaceLines:{
+        inverse = EditDelta(EditDelta::ReplaceLines, 0, delta.y, delta.lines.size());
+        inverse.lines = content_.mid(delta.y, delta.count);
+        foreach (const LineRef& l, inverse.lines)
+            height_ -= l->line.height();
+        content_.remove(delta.y, delta.count);
+        content_.insert(delta.y, delta.lines.size(), LineRef());
+        for(int i = 0; i < delta.lines.size(); ++i){
+            content_[delta.y + i] = delta.lines.at(i);
+            height_ += delta.lines.at(i)->line.height();
+        }
+        lines_changed(delta.y, delta.count, delta.lines.size());
+        break;
+    }
+    }
+    ++version_;
+    return inverse;
+}
 
-    if(source->length() > 1)
-        pos.setX((*source)[source->length() - 1].length());
-    else
-        pos.setX(pos.x() + (*source)[0].length());
+EditCommand Text::replay(const EditCommand &command)
+{
+    EditCommand inverse;
+    inverse.before = command.before;
+    inverse.after = command.after;
+    recording_ = true;
+    for(int i = command.deltas.size() - 1; i >= 0; --i)
+        inverse.deltas.append(apply_delta(command.deltas.at(i)));
+    recording_ = false;
+    return inverse;
 }
 
 void Text::raise_height(int h)
@@ -1,54 +1,77 @@
 #ifndef CHAR_H
 #define CHAR_H
 
-#include <QtWidgets>
+#include <QtGui>
+
+#include "arena.h"
+#include "fonttable.h"
+#include "jobs.h"
+#include "memory.h"
+#include "trace.h"
+#include "gapbuffer.h"
 
 class Symbol;
 class Line;
 class Text;
-
-typedef QList<Symbol> SymbolList;
-typedef QList<Line> LineList;
+class Highlighter;
+class UndoStack;
+struct EditDelta;
+struct EditCommand;
+struct SearchMatch;
 
 class Symbol
 {
 public:
     Symbol();
     Symbol(QChar value);
+    Symbol(QChar value, quint16 style);
     explicit Symbol(QFont font);
     explicit Symbol(const QFont& font, QChar value);
-    Symbol(const Symbol&);
-    Symbol& operator=(const Symbol&);
-    ~Symbol();
 
-    inline bool bold() const { return font_.bold(); }
-    inline void setBold(bool bold) { font_.setBold(bold); }
+    inline bool bold() const { return font().bold(); }
+    void setBold(bool bold);
+
+    inline const QFont& font() const { return FontTable::instance().font(style_); }
+    inline void setFont(const QFont& font) { style_ = FontTable::instance().intern(font); }
 
-    inline const QFont& font() const { return font_; }
-    inline void setFont(const QFont& font) { font_ = QFont(font); }
+    inline bool italic() const { return font().italic(); }
+    void setItalic(bool italic);
 
-    inline bool italic() const { return font_.italic(); }
-    inline void setItalic(bool italic) { font_.setItalic(italic); }
+    inline qint64 height() const { return FontTable::instance().height(style_); }
+    inline qint64 width() const { return FontTable::instance().width(style_, value_); }
 
-    inline qint64 height() const { return QFontMetrics(font_).height(); }
-    inline qint64 width() const { return QFontMetrics(font_).width(value_); }
+    inline quint16 style() const { return style_; }
+    inline void setStyle(quint16 style) { style_ = style; }
 
     inline QChar value() const { return value_; }
     inline void setValue(QChar value) { value_ = value; }
 
 private:
-    QFont font_;
-
     QChar value_;
+    quint16 style_;
 };
 
-class Line : public QObject
+Q_DECLARE_TYPEINFO(Symbol, Q_MOVABLE_TYPE);
+
+struct HighlightSpan
 {
-    Q_OBJECT
+    HighlightSpan() : begin(0), length(0), color(0) {}
+    HighlightSpan(int b, int l, QRgb c) : begin(b), length(l), color(c) {}
+
+    int begin;
+    int length;
+    QRgb color;
+};
+
+Q_DECLARE_TYPEINFO(HighlightSpan, Q_PRIMITIVE_TYPE);
 
+typedef QVector<HighlightSpan> HighlightSpans;
+
+class Line
+{
 public:
-    explicit Line(QObject *parent = Q_NULLPTR);
-    explicit Line(int height, QObject *parent = Q_NULLPTR);
+    explicit Line(const ArenaRef& arena = ArenaRef());
+    explicit Line(int height, const ArenaRef& arena = ArenaRef());
     Line(const Line&);
     Line& operator=(const Line&);
     ~Line();
@@ -59,16 +82,26 @@ public:
     void recountHeight();
 
     inline int getWidth() const { return width_; }
-    inline int length() const { return content_.length(); }
-    inline int size() const { return content_.size(); }
+    inline int length() const { return size(); }
+    inline int size() const { return wide_ ? extra_->utf16.size() : latin1_.size(); }
     void recountWidth();
 
-    inline bool isEmpty() const { return !content_.size(); }
+    inline bool isEmpty() const { return !size(); }
+    void compact();
+    bool isCompact() const;
+    qint64 memoryUsage() const;
+
+    inline bool isWide() const { return wide_; }
+    inline bool isUniform() const { return !mixed_; }
+
+    inline const ArenaRef& arena() const { return arena_; }
+    void setArena(const ArenaRef& arena);
 
     Symbol pop_front();
     Symbol pop_back();
     void push_front(const Symbol&);
     void push_back(const Symbol&);
+    void append(const QChar *values, int count, quint16 style);
     void insert(int pos, const Symbol&);
     Symbol erase(int pos);
 
@@ -76,22 +109,109 @@ public:
     int getSymbolBegin(int x, QPoint &pos) const;
     inline int getDifference(int s) const;
     Line getNewLine(int pos);
-    void draw(QPainter *painter, qint64 x, qint64 y) const;
+    Line mid(int from, int to) const;
+    void draw(QPainter *painter, qint64 x, qint64 y,
+              const HighlightSpans& spans = HighlightSpans()) const;
+
+    inline QChar valueAt(int pos) const
+    {
+        return wide_ ? extra_->utf16.at(pos) : QChar(static_cast<ushort>(latin1_.at(pos)));
+    }
+    inline quint16 styleAt(int pos) const { return mixed_ ? extra_->styles.at(pos) : style_; }
+    void setStyle(int pos, quint16 style);
+    void setStyle(int from, int to, quint16 style);
+
+    int indexOf(const QString& needle, int from = 0, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+    QString text() const;
 
-    Symbol& operator[](int);
-    inline const Symbol& at(int pos) const { return content_[pos]; }
+    inline Symbol operator[](int pos) const { return at(pos); }
+    inline Symbol at(int pos) const { return Symbol(valueAt(pos), styleAt(pos)); }
 
 private:
+    struct Extra
+    {
+        explicit Extra(Arena *arena) : utf16(arena), styles(arena, Arena::StyleUsage) { charge(1); }
+        Extra(const Extra& other) : utf16(other.utf16), styles(other.styles) { charge(1); }
+        ~Extra() { charge(-1); }
+
+        void setArena(Arena *arena)
+        {
+            charge(-1);
+            utf16.setArena(arena);
+            styles.setArena(arena);
+            charge(1);
+        }
+
+        inline void charge(int sign)
+        {
+            if(utf16.arena())
+                utf16.arena()->charge(Arena::LineUsage, sign * qint64(sizeof(Extra)));
+        }
+
+        GapBuffer<QChar> utf16;
+        GapBuffer<quint16> styles;
+    };
+
     void raise_height(int);
     void reduce_height(int);
-
-    SymbolList content_;
+    int max_symbol_height() const;
+    inline int symbol_width(int pos) const;
+    bool can_narrow() const;
+    bool can_unify() const;
+    void ensure_extra();
+    void promote();
+    void materialize_styles();
+
+    ArenaRef arena_;
+    GapBuffer<uchar> latin1_;
+    Extra *extra_;
+    quint16 style_;
+    bool wide_;
+    bool mixed_;
 
     qint64 width_;
     qint64 height_;
     qint64 maxHeight_;
 };
 
+Q_DECLARE_TYPEINFO(Line, Q_MOVABLE_TYPE);
+
+struct LineNode : public QSharedData
+{
+    LineNode() : stamp(0) {}
+    explicit LineNode(const Line& l) : line(l), stamp(0) {}
+    LineNode(const LineNode& other) : QSharedData(other), line(other.line), stamp(0) {}
+
+    Line line;
+    mutable quint64 stamp;
+};
+
+typedef QSharedDataPointer<LineNode> LineRef;
+typedef QVector<LineRef> LineList;
+
+class TextSnapshot
+{
+public:
+    TextSnapshot() : version_(0), height_(0) {}
+
+    inline quint64 version() const { return version_; }
+    inline bool isNull() const { return lines_.isEmpty(); }
+
+    inline int length() const { return lines_.size(); }
+    inline const Line& at(int pos) const { return lines_.at(pos)->line; }
+    inline const LineNode *node(int pos) const { return lines_.at(pos).constData(); }
+    inline qint64 height() const { return height_; }
+
+    TextSnapshot copy(const ArenaRef& arena) const;
+
+private:
+    friend class Text;
+
+    LineList lines_;
+    quint64 version_;
+    qint64 height_;
+};
+
 
 class Text: public QObject
 {
@@ -100,18 +220,33 @@ class Text: public QObject
 public:
     explicit Text(QObject *parent = Q_NULLPTR);
     explicit Text(int h, QObject *parent = Q_NULLPTR);
+    explicit Text(const ArenaRef& arena, QObject *parent = Q_NULLPTR);
     Text(const Text&);
     ~Text();
 
     Text& operator=(const Text&);
-    Line& operator[](int);
 
-    inline const Line& at(int pos) const{ return content_[pos]; }
+    inline const Line& at(int pos) const{ return line_ref(pos); }
+
+    inline quint64 version() const { return version_; }
+    TextSnapshot snapshot() const;
 
     inline qint64 height() const { return height_; }
     qint64 width() const;
     void recountHeight();
     inline int length() const { return content_.length(); }
+    int lineAt(qint64 y) const;
+
+    inline const ArenaRef& arena() const { return arena_; }
+    void memoryUsage(MemoryUsage& usage) const;
+
+    inline int activeLine() const { return activeLine_; }
+    void setActiveLine(int l);
+
+    inline UndoStack *undoStack() const { return undo_; }
+    void setUndoEnabled(bool enabled);
+    bool undo(QPoint &pos);
+    bool redo(QPoint &pos);
 
     int getLineShift(int l, int s) const;
     int getLineRoof(int l) const;
@@ -119,22 +254,28 @@ public:
     Line erase(int pos);
     void insert(int pos, const Line &);
     void insert(int posX, int posY, const Symbol &);
-    Line &pop_front();
-    Line &pop_back();
+    Line pop_front();
+    Line pop_back();
     void push_front( const Line &);
     void push_back( const Line &);
 
     Symbol getSymbol(int i, int j);
     void eraseSymbol(int x, int y, QPoint &pos);
     void deleteText(const QPoint& begin,const QPoint& end);
+    void breakLine(QPoint &pos);
+    int replace(const QVector<SearchMatch>& matches, const QString& text);
 
     QPoint getShiftByCoord(QPoint p, QPoint &pos) const;
     QPoint getShiftByPos(int x, int y, QPoint &pos) const;
-    qint64 draw(QPainter *painter, QPoint curPos, QPoint edge) const;
+    qint64 draw(QPainter *painter, QPoint curPos, QPoint edge,
+                const Highlighter *highlighter = Q_NULLPTR, int first = 0, int last = -1) const;
 
-    void copyPart(Text* res, QPoint beginPos, QPoint endPos);
-    void cutPart(Text* res, QPoint beginPos, QPoint endPos);
-    void insertPart(Text* source, QPoint &pos);
+    TextSnapshot slice(QPoint beginPos, QPoint endPos) const;
+    TextSnapshot cutPart(QPoint beginPos, QPoint endPos);
+    void insertPart(const TextSnapshot& source, QPoint &pos);
+    void appendLines(const TextSnapshot& source);
+    static TextSnapshot fromPlainText(const QString& text, const QFont& font,
+                                      const ArenaRef& arena = ArenaRef());
 
     template <class T>
     using qFontF = void (QFont::*) (T);
@@ -142,52 +283,123 @@ public:
     template <class Argument>
     void fontF(qFontF<Argument> func, QPoint begin, QPoint end, Argument arg)
     {
+        TRACE_SCOPE("Text::fontF");
+        ++version_;
+        bool record = begin_record();
+        LineList before;
+        if(record)
+            before = content_.mid(begin.y(), end.y() - begin.y() + 1);
+        QHash<quint16, quint16> styles;
         if(begin.y() < end.y())
         {
-            for(int j = begin.x(); j < content_[begin.y()].size(); ++j)
-            {
-                QFont f = content_[begin.y()][j].font();
-                (f.*func)(arg);
-                content_[begin.y()][j].setFont(f);
-            }
-
-            for(int i = begin.y() + 1; i < end.y(); ++i)
-                for(int j = 0; j < content_[i].length(); ++j)
-                {
-                    QFont f = content_[i][j].font();
-                    (f.*func)(arg);
-                    content_[i][j].setFont(f);
+            apply_font_func<Argument>(line_ref(begin.y()), begin.x(), line_ref(begin.y()).size(),
+                                      func, arg, styles);
+            apply_font_func<Argument>(line_ref(end.y()), 0, end.x(), func, arg, styles);
+            int first = begin.y() + 1;
+            content_.detach();
+            JobPool::instance().parallelFor(JobPool::Interactive, end.y() - first, STYLE_GRAIN,
+                                            [this, first, func, arg](int from, int to) {
+                QHash<quint16, quint16> local;
+                for(int i = first + from; i < first + to; ++i){
+                    Line& line = line_ref(i);
+                    apply_font_func<Argument>(line, 0, line.length(), func, arg, local);
+                    line.recountHeight();
+                    line.recountWidth();
                 }
-            for(int j = 0; j < end.x(); ++j)
-            {
-                QFont f = content_[end.y()][j].font();
-                (f.*func)(arg);
-                content_[end.y()][j].setFont(f);
-            }
-            for(int i = begin.y(); i <= end.y(); ++i){
-                content_[i].recountHeight();
-                content_[i].recountWidth();
-            }
+            });
+            line_ref(begin.y()).recountHeight();
+            line_ref(begin.y()).recountWidth();
+            line_ref(end.y()).recountHeight();
+            line_ref(end.y()).recountWidth();
         }
         else{
-            for(int j = begin.x(); j < end.x(); ++j)
-            {
-                QFont f = content_[begin.y()][j].font();
-                (f.*func)(arg);
-                content_[begin.y()][j].setFont(f);
-            }
-            content_[begin.y()].recountHeight();
-            content_[begin.y()].recountWidth();
+            apply_font_func<Argument>(line_ref(begin.y()), begin.x(), end.x(), func, arg, styles);
+            line_ref(begin.y()).recountHeight();
+            line_ref(begin.y()).recountWidth();
         }
         recountHeight();
+        lines_changed(begin.y(), end.y() - begin.y() + 1, end.y() - begin.y() + 1);
+        if(record)
+            end_record_lines(begin.y(), before.size(), before, begin, end);
     }
 
+signals:
+    void linesChanged(int line, int removed, int added);
+
 private:
+    enum { STYLE_GRAIN = 2048, PASTE_GRAIN = 4096 };
+
     void raise_height(int);
     void reduce_height(int);
+    inline void adopt(Line& line)
+    {
+        if(line.arena() != arena_)
+            line.setArena(arena_);
+    }
+    void extend_roofs(int line, qint64 y) const;
+    inline void lines_changed(int line, int removed, int added)
+    {
+        if(roofsValid_ > line + 1)
+            roofsValid_ = line + 1;
+        emit linesChanged(line, removed, added);
+    }
 
+    bool begin_record();
+    void end_record();
+    void end_record(const EditDelta& inverse, QPoint before, QPoint after);
+    void end_record_lines(int y, int count, const LineList& lines, QPoint before, QPoint after);
+    EditDelta apply_delta(const EditDelta& delta);
+    EditCommand replay(const EditCommand& command);
+    inline Line& line_ref(int pos)
+    {
+        LineNode *node = content_[pos].data();
+        node->stamp = 0;
+        adopt(node->line);
+        return node->line;
+    }
+    inline const Line& line_ref(int pos) const { return content_.at(pos)->line; }
+
+    template <class Argument>
+    static quint16 font_func_style(quint16 style, qFontF<Argument> func, Argument arg,
+                                   QHash<quint16, quint16>& styles)
+    {
+        QHash<quint16, quint16>::const_iterator it = styles.constFind(style);
+        if(it != styles.constEnd())
+            return it.value();
+        QFont f = FontTable::instance().font(style);
+        (f.*func)(arg);
+        quint16 result = FontTable::instance().intern(f);
+        styles.insert(style, result);
+        return result;
+    }
+
+    template <class Argument>
+    static void apply_font_func(Line& line, int from, int to, qFontF<Argument> func, Argument arg,
+                                QHash<quint16, quint16>& styles)
+    {
+        if(from >= to)
+            return;
+        if(line.isUniform()){
+            line.setStyle(from, to, font_func_style<Argument>(line.styleAt(from), func, arg, styles));
+            return;
+        }
+        for(int j = from; j < to; ++j)
+            line.setStyle(j, font_func_style<Argument>(line.styleAt(j), func, arg, styles));
+    }
+
+    ArenaRef arena_;
     LineList content_;
     qint64 height_;
+    int activeLine_;
+    quint64 version_;
+    UndoStack *undo_;
+    bool recording_;
+
+    // roofs_[i] is the top of line i; only the first roofsValid_ entries are current.
+    mutable QVector<qint64> roofs_;
+    mutable int roofsValid_;
 };
 
+Q_DECLARE_METATYPE(TextSnapshot)
+
 #endif
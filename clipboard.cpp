@@ -0,0 +1,99 @@
+#include "clipboard.h"
+#include "filerecord.h"
+
+const char *SliceMimeData::STYLED_FORMAT = "application/x-texteditor-text+xml";
+
+SliceMimeData::SliceMimeData(const TextSnapshot &slice, const Text *source)
+    : slice_(slice), plainReady_(false), styledReady_(false)
+{
+    if(source)
+        connect(source, SIGNAL( destroyed() ), SLOT( on_source_destroyed() ) );
+}
+
+// The slice shares lines with the document it was taken from; once that
+// document closes they move to an arena of their own so the clipboard does
+// not keep the whole document's blocks alive.
+void SliceMimeData::on_source_destroyed()
+{
+    slice_ = slice_.copy(ArenaRef(new Arena));
+}
+
+QStringList SliceMimeData::formats() const
+{
+    return QStringList() << QString("text/plain") << QString(STYLED_FORMAT);
+}
+
+bool SliceMimeData::hasFormat(const QString &mimeType) const
+{
+    return mimeType == "text/plain" || mimeType == STYLED_FORMAT;
+}
+
+QVariant SliceMimeData::retrieveData(const QString &mimeType, QVariant::Type type) const
+{
+    TRACE_SCOPE("SliceMimeData::retrieveData");
+    if(mimeType == "text/plain"){
+        if(!plainReady_){
+            plain_ = plainText(slice_);
+            plainReady_ = true;
+        }
+        if(type == QVariant::ByteArray)
+            return plain_.toUtf8();
+        return plain_;
+    }
+    if(mimeType == STYLED_FORMAT){
+        if(!styledReady_){
+            QBuffer buffer(&styled_);
+            buffer.open(QIODevice::WriteOnly);
+            FileRecord().writeXml(slice_, &buffer);
+            styledReady_ = true;
+        }
+        return styled_;
+    }
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+void SliceMimeData::memoryUsage(MemoryUsage &usage) const
+{
+    // Whole lines are shared with the document; only the cut edges and
+    // exported formats belong to the clipboard.
+    qint64 bytes = qint64(slice_.length()) * sizeof(LineRef) + plain_.capacity() * sizeof(QChar) +
+            styled_.capacity();
+    for(int i = 0; i < slice_.length(); i += qMax(1, slice_.length() - 1))
+        if(slice_.node(i)->ref.load() == 1)
+            bytes += slice_.at(i).memoryUsage();
+    usage.add(MemoryUsage::Clipboard, bytes);
+}
+
+QString SliceMimeData::plainText(const TextSnapshot &slice)
+{
+    int size = qMax(0, slice.length() - 1);
+    for(int i = 0; i < slice.length(); ++i)
+        size += slice.at(i).length();
+    QString text;
+    text.reserve(size);
+    for(int i = 0; i < slice.length(); ++i){
+        if(i)
+            text += QChar('\n');
+        const Line& line = slice.at(i);
+        for(int j = 0; j < line.length(); ++j)
+            text += line.valueAt(j);
+    }
+    return text;
+}
+
+TextSnapshot SliceMimeData::decode(const QByteArray &styled, const QString &plain, const QFont &font,
+                                   const ArenaRef &arena)
+{
+    if(!styled.isEmpty()){
+        QByteArray data = styled;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        Text text;
+        FileRecord().readXml(&buffer, &text);
+        if(text.length())
+            return text.snapshot();
+    }
+    if(!plain.isNull())
+        return Text::fromPlainText(plain, font, arena);
+    return TextSnapshot();
+}
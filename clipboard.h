@@ -0,0 +1,45 @@
+#ifndef CLIPBOARD_H
+#define CLIPBOARD_H
+
+#include <QtGui>
+
+#include "char.h"
+#include "memory.h"
+
+// Clipboard payload that keeps a shared slice of the document and only
+// converts it when another application asks for a format.
+class SliceMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit SliceMimeData(const TextSnapshot& slice, const Text *source = Q_NULLPTR);
+
+    static const char *STYLED_FORMAT;
+
+    inline const TextSnapshot& slice() const { return slice_; }
+
+    QStringList formats() const;
+    bool hasFormat(const QString &mimeType) const;
+
+    void memoryUsage(MemoryUsage& usage) const;
+
+    static QString plainText(const TextSnapshot& slice);
+    static TextSnapshot decode(const QByteArray& styled, const QString& plain, const QFont& font,
+                               const ArenaRef& arena = ArenaRef());
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QVariant::Type type) const;
+
+private slots:
+    void on_source_destroyed();
+
+private:
+    TextSnapshot slice_;
+    mutable QString plain_;
+    mutable QByteArray styled_;
+    mutable bool plainReady_;
+    mutable bool styledReady_;
+};
+
+#endif
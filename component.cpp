@@ -6,21 +6,23 @@ MenuComponents::MenuComponents(QWidget *parent)
     createFileActions();
     createEditActions();
     createFontActions();
+    createViewActions();
     fontTypeMenu = new QMenu(tr("Font"), this);
     fontSizeMenu = new QMenu(tr("Size"), this);
 
-    QFontDatabase fdb;
-    fonts << fdb.families();
+    // Font families are enumerated off the GUI thread once the event loop runs;
+    // the menu shows them through a filtered list view instead of one action each.
+    fontModel = new FontListModel(this);
+    FontPicker *fontPicker = new FontPicker(fontModel);
+    QWidgetAction *fontPickerAction = new QWidgetAction(fontTypeMenu);
+    fontPickerAction->setDefaultWidget(fontPicker);
+    fontTypeMenu->addAction(fontPickerAction);
+    connect(fontPicker, SIGNAL( fontChosen(QString) ), SLOT( chooseFontFamily(QString) ) );
+    QTimer::singleShot(0, fontModel, SLOT( load() ) );
 
     fontSizes << "4" << "8" << "12" << "14" << "16" << "18" << "20"
               << "24" << "28" << "32" << "36" << "40" << "48";
 
-    QList<QAction*> fontActions;
-    foreach (QString font, fonts) {
-        fontActions.push_back(new QAction(font, this));
-    }
-    fontTypeMenu->addActions(fontActions);
-
     QList<QAction*> fontSizeActions;
     foreach (QString fontSize, fontSizes) {
         fontSizeActions.push_back(new QAction(fontSize, this));
@@ -32,6 +34,13 @@ MenuComponents::~MenuComponents()
 {
 }
 
+void MenuComponents::chooseFontFamily(const QString &family)
+{
+    while(QWidget *popup = QApplication::activePopupWidget())
+        popup->close();
+    emit fontFamilyChosen(family);
+}
+
 void MenuComponents::createFileActions()
 {
     newAction = new QAction(tr("New"), this);
@@ -64,6 +73,12 @@ void MenuComponents::createFileActions()
 
 void MenuComponents::createEditActions()
 {
+    undoAction = new QAction(tr("Undo"), this);
+    undoAction->setShortcut(QKeySequence::Undo);
+
+    redoAction = new QAction(tr("Redo"), this);
+    redoAction->setShortcut(QKeySequence::Redo);
+
     cutAction = new QAction(tr("Cut"), this);
     cutAction->setIcon(QIcon(":/icons/icons/cut.png"));
     cutAction->setShortcut(QKeySequence::Cut);
@@ -79,6 +94,18 @@ void MenuComponents::createEditActions()
     deleteAction = new QAction(tr("Delete"), this);
     deleteAction->setIcon(QIcon(":/icons/icons/delete.png"));
     deleteAction->setShortcut(QKeySequence::Delete);
+
+    findAction = new QAction(tr("Find"), this);
+    findAction->setShortcut(QKeySequence::Find);
+
+    findNextAction = new QAction(tr("Find Next"), this);
+    findNextAction->setShortcut(QKeySequence::FindNext);
+
+    findPreviousAction = new QAction(tr("Find Previous"), this);
+    findPreviousAction->setShortcut(QKeySequence::FindPrevious);
+
+    searchIndexAction = new QAction(tr("Index for Search"), this);
+    searchIndexAction->setCheckable(true);
 }
 
 void MenuComponents::createFontActions()
@@ -102,12 +129,62 @@ void MenuComponents::addFileActions(QWidget *menu)
 
 void MenuComponents::addEditActions(QWidget *menu)
 {
+    menu->addAction(undoAction);
+    menu->addAction(redoAction);
     menu->addAction(cutAction);
     menu->addAction(copyAction);
     menu->addAction(pasteAction);
 
 }
 
+void MenuComponents::addFindActions(QWidget *menu)
+{
+    menu->addAction(findAction);
+    menu->addAction(findNextAction);
+    menu->addAction(findPreviousAction);
+    menu->addAction(searchIndexAction);
+}
+
+void MenuComponents::createViewActions()
+{
+    latencyHudAction = new QAction(tr("Latency HUD"), this);
+    latencyHudAction->setCheckable(true);
+    latencyHudAction->setShortcut(Qt::Key_F12);
+
+    dumpLatencyAction = new QAction(tr("Dump Latency..."), this);
+
+    recordInputAction = new QAction(tr("Record Input"), this);
+    recordInputAction->setCheckable(true);
+    recordInputAction->setShortcut(Qt::SHIFT + Qt::Key_F12);
+
+    memoryUsageAction = new QAction(tr("Memory Usage"), this);
+    memoryUsageAction->setCheckable(true);
+
+#ifdef TEXTEDITOR_TRACE
+    saveTraceAction = new QAction(tr("Save Trace..."), this);
+#else
+    saveTraceAction = Q_NULLPTR;
+#endif
+
+#ifdef TEXTEDITOR_ALLOC_PROFILE
+    saveAllocProfileAction = new QAction(tr("Save Allocation Profile..."), this);
+#else
+    saveAllocProfileAction = Q_NULLPTR;
+#endif
+}
+
+void MenuComponents::addViewActions(QWidget *menu)
+{
+    menu->addAction(latencyHudAction);
+    menu->addAction(dumpLatencyAction);
+    menu->addAction(recordInputAction);
+    menu->addAction(memoryUsageAction);
+    if(saveTraceAction)
+        menu->addAction(saveTraceAction);
+    if(saveAllocProfileAction)
+        menu->addAction(saveAllocProfileAction);
+}
+
 void MenuComponents::addFontActions(QWidget *menu)
 {
     menu->addAction(fontBoldAction);
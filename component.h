@@ -3,6 +3,8 @@
 
 #include <QtWidgets>
 
+#include "fontlist.h"
+
 class MenuComponents : public QWidget
 {
     Q_OBJECT
@@ -14,7 +16,9 @@ public:
     void addFileActions(QWidget *menu);
     void addRecentFilesActions(QWidget *menu);
     void addEditActions(QWidget *menu);
+    void addFindActions(QWidget *menu);
     void addFontActions(QWidget *menu);
+    void addViewActions(QWidget *menu);
     void addDropDawnFontActions(QMenu *menu);
     void addExitAction(QWidget *menu);
 
@@ -27,29 +31,47 @@ public:
     QAction *recentFileActions[MAX_RECENT_FILES];
     QAction *exitAction;
 
+    QAction *undoAction;
+    QAction *redoAction;
     QAction *cutAction;
     QAction *copyAction;
     QAction *pasteAction;
     QAction *deleteAction;
 
+    QAction *findAction;
+    QAction *findNextAction;
+    QAction *findPreviousAction;
+    QAction *searchIndexAction;
+
+    QAction *latencyHudAction;
+    QAction *dumpLatencyAction;
+    QAction *recordInputAction;
+    QAction *memoryUsageAction;
+    QAction *saveTraceAction;
+    QAction *saveAllocProfileAction;
+
     QAction *fontBoldAction;
     QAction *fontItalicAction;
 
     QMenu *fontTypeMenu;
     QMenu *fontSizeMenu;
+    FontListModel *fontModel;
 
-    inline const QStringList& getFontList() const { return fonts; }
     inline const QStringList& getFontSizeList() const { return fontSizes; }
 
-public slots:
+signals:
+    void fontFamilyChosen(const QString &family);
+
+private slots:
+    void chooseFontFamily(const QString &family);
 
 private:
     QString resentFileNames[MAX_RECENT_FILES];
     void createFileActions();
     void createEditActions();
     void createFontActions();
+    void createViewActions();
 
-    QStringList fonts;
     QStringList fontSizes;
 };
 
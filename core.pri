@@ -0,0 +1,38 @@
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CONFIG(trace): DEFINES += TEXTEDITOR_TRACE
+CONFIG(allocprofile): DEFINES += TEXTEDITOR_ALLOC_PROFILE
+
+CORE_HEADERS = \
+    $$PWD/allocprofile.h \
+    $$PWD/arena.h \
+    $$PWD/char.h \
+    $$PWD/clipboard.h \
+    $$PWD/filerecord.h \
+    $$PWD/fonttable.h \
+    $$PWD/gapbuffer.h \
+    $$PWD/highlighter.h \
+    $$PWD/jobs.h \
+    $$PWD/memory.h \
+    $$PWD/scheduler.h \
+    $$PWD/search.h \
+    $$PWD/trace.h \
+    $$PWD/trigram.h \
+    $$PWD/undo.h
+
+CORE_SOURCES = \
+    $$PWD/allocprofile.cpp \
+    $$PWD/arena.cpp \
+    $$PWD/char.cpp \
+    $$PWD/clipboard.cpp \
+    $$PWD/filerecord.cpp \
+    $$PWD/fonttable.cpp \
+    $$PWD/highlighter.cpp \
+    $$PWD/jobs.cpp \
+    $$PWD/memory.cpp \
+    $$PWD/scheduler.cpp \
+    $$PWD/search.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/trigram.cpp \
+    $$PWD/undo.cpp
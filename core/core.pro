@@ -0,0 +1,11 @@
+QT += core gui \
+      xml
+
+TEMPLATE = lib
+CONFIG += staticlib
+TARGET = texteditorcore
+
+include(../core.pri)
+
+HEADERS += $$CORE_HEADERS
+SOURCES += $$CORE_SOURCES
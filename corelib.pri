@@ -0,0 +1,16 @@
+include($$PWD/core.pri)
+
+CORE_OUT = $$OUT_PWD/../core
+win32 {
+    CONFIG(debug, debug|release): CORE_OUT = $$CORE_OUT/debug
+    else: CORE_OUT = $$CORE_OUT/release
+}
+
+LIBS += -L$$CORE_OUT -ltexteditorcore
+win32-msvc*: PRE_TARGETDEPS += $$CORE_OUT/texteditorcore.lib
+else: PRE_TARGETDEPS += $$CORE_OUT/libtexteditorcore.a
+
+CONFIG(allocprofile):linux {
+    LIBS += -ldl
+    QMAKE_LFLAGS += -rdynamic
+}
@@ -40,8 +40,32 @@ TextField::TextField(QFont f, QWidget *parent)
     cursor_->setColorHighlighted(highlightningColor_);
 
     textLines_ = new Text(QFontMetrics(font()).height(), this);
-
-    textBuffer_= new Text(QFontMetrics(font()).height(), this);
+    textLines_->setUndoEnabled(true);
+    connect(textLines_, SIGNAL( linesChanged(int, int, int) ), SLOT( on_lines_changed(int, int, int) ) );
+
+    highlighter_ = new Highlighter(this);
+    highlighter_->setText(textLines_);
+    firstVisible_ = 0;
+    lastVisible_ = -1;
+    documentWidth_ = 0;
+    widestLine_ = -1;
+    measuring_ = false;
+    measureLine_ = 0;
+    measureWidest_ = 0;
+    measureWidestLine_ = -1;
+    connect(highlighter_, SIGNAL( highlightChanged(int, int) ), SLOT( on_highlight_changed(int, int) ) );
+
+    hud_ = new LatencyHud(this);
+    hud_->move(HUD_MARGIN, HUD_MARGIN);
+    hud_->hide();
+
+    frameTimer_ = new QTimer(this);
+    frameTimer_->setSingleShot(true);
+    frameTimer_->setInterval(FRAME_INTERVAL);
+    viewPending_ = false;
+    dragPending_ = false;
+    dragStamp_ = 0;
+    connect(frameTimer_, SIGNAL( timeout() ), SLOT( on_frame_timer() ) );
 
     setCapsLock(false);
 
@@ -52,7 +76,6 @@ TextField::~TextField()
 {
     delete field_;
     delete cursor_;
-    delete textBuffer_;
     delete textLines_;
 }
 
@@ -92,6 +115,7 @@ void TextField::changeItalics(bool it)
 
 void TextField::moveHViewPort(int value)
 {
+    TRACE_SCOPE("TextField::moveHViewPort");
     qint64 topLeftX = viewport()->rect().topLeft().x();
     qint64 topLeftY = viewport()->rect().topLeft().y();
 
@@ -101,6 +125,7 @@ void TextField::moveHViewPort(int value)
 
 void TextField::moveVViewPort(int value)
 {
+    TRACE_SCOPE("TextField::moveVViewPort");
     qint64 topLeftX = viewport()->rect().topLeft().x();
     qint64 topLeftY = viewport()->rect().topLeft().y();
 
@@ -110,6 +135,7 @@ void TextField::moveVViewPort(int value)
 
 void TextField::scrollViewport(QPoint pos)
 {
+    TRACE_SCOPE("TextField::scrollViewport");
     QPoint shift = textLines_->getShiftByPos(pos.x(), pos.y(), pos);
     int marginX = 2 * edge_.x() + verticalScrollBar()->height();
     int marginY = edge_.y() + 0.2 * horizontalScrollBar()->height();
@@ -149,23 +175,137 @@ void TextField::setTextEditorView(Qt::GlobalColor color)
 
 void TextField::clear()
 {
-    selectAll();
-    QPoint p = _handle_backspace();
+    _flush_view();
+    pasteJob_.cancel();
+    delete textLines_;
+    textLines_ = new Text(QFontMetrics(font()).height(), this);
+    textLines_->setUndoEnabled(true);
+    connect(textLines_, SIGNAL( linesChanged(int, int, int) ), SLOT( on_lines_changed(int, int, int) ) );
+    highlighter_->setText(textLines_);
+    documentWidth_ = 0;
+    widestLine_ = -1;
+    _schedule_measure();
+    setSelected(false);
+    setCurrentPos(QPoint(0, 0));
+    QPoint p = textLines_->getShiftByPos(0, 0, curPos_);
     _set_cursor_points(p);
 }
 
 void TextField::setText(const Text* text) {
+    _flush_view();
+    pasteJob_.cancel();
     if(textLines_)
         delete textLines_;
     textLines_ = new Text(*text);
     textLines_->setParent(this);
+    textLines_->setUndoEnabled(true);
+    connect(textLines_, SIGNAL( linesChanged(int, int, int) ), SLOT( on_lines_changed(int, int, int) ) );
+    highlighter_->setText(textLines_);
+    documentWidth_ = 0;
+    widestLine_ = -1;
+    _schedule_measure();
+}
+
+void TextField::appendText(const TextSnapshot &lines)
+{
+    if(lines.isNull())
+        return;
+    textLines_->appendLines(lines);
+    resize_field(_document_width(), textLines_->height());
+    viewport()->update();
+}
+
+MemoryUsage TextField::memoryUsage() const
+{
+    MemoryUsage usage;
+    textLines_->memoryUsage(usage);
+    const SliceMimeData *clipboard =
+            qobject_cast<const SliceMimeData*>(QGuiApplication::clipboard()->mimeData());
+    if(clipboard)
+        clipboard->memoryUsage(usage);
+    usage.add(MemoryUsage::Metrics, FontTable::instance().memoryUsage());
+    usage.add(MemoryUsage::Highlight, highlighter_->memoryUsage());
+    if(textLines_->undoStack())
+        usage.add(MemoryUsage::Undo, textLines_->undoStack()->bytes());
+    return usage;
+}
+
+void TextField::setSyntax(const SyntaxDefinition *definition)
+{
+    highlighter_->setDefinition(definition);
+    viewport()->update();
+}
+
+// Changed and inserted lines are folded into the running maximum, so edits
+// do not restart the measurement. The document only becomes narrower when
+// the widest line shrinks or goes away, and only then is it measured again.
+void TextField::on_lines_changed(int line, int removed, int added)
+{
+    qint64 widest = -1;
+    int widestAt = -1;
+    for(int i = line; i < line + added; ++i){
+        qint64 width = textLines_->at(i).getWidth();
+        if(width > widest){
+            widest = width;
+            widestAt = i;
+        }
+    }
+    if(measuring_){
+        if(measureLine_ >= line + removed)
+            measureLine_ += added - removed;
+        else if(measureLine_ > line)
+            measureLine_ = line + added;
+        if(!_fold_width(measureWidest_, measureWidestLine_, line, removed, added, widest, widestAt))
+            _schedule_measure();
+    }
+    if(!_fold_width(documentWidth_, widestLine_, line, removed, added, widest, widestAt) && !measuring_)
+        _schedule_measure();
+}
+
+// Folds the lines that replaced `removed` lines at `line` into a maximum;
+// false when the line holding it was replaced by narrower ones.
+bool TextField::_fold_width(qint64 &width, int &widestLine, int line, int removed, int added,
+                            qint64 widest, int widestAt)
+{
+    bool replaced = widestLine >= line && widestLine < line + removed;
+    if(widestLine >= line + removed)
+        widestLine += added - removed;
+    if(widestAt >= 0 && widest >= width){
+        width = widest;
+        widestLine = widestAt;
+        return true;
+    }
+    if(replaced)
+        widestLine = -1;
+    return !replaced;
+}
+
+void TextField::on_highlight_changed(int first, int last)
+{
+    if(first <= lastVisible_ && last >= firstVisible_)
+        viewport()->update();
+}
+
+void TextField::on_frame_timer()
+{
+    _flush_view();
+}
+
+void TextField::setLatencyHudVisible(bool visible)
+{
+    hud_->setVisible(visible);
+    hud_->raise();
 }
 
 void TextField::keyPressEvent(QKeyEvent *event)
 {
-    int x = cursor_->x() - edge_.x();
-    int y = cursor_->y() - edge_.y();
-    QPoint p = QPoint(x, y);
+    TRACE_SCOPE("TextField::keyPressEvent");
+    ALLOC_SCOPE(Keystroke);
+    qint64 stamp = LatencyMonitor::now();
+    LatencyScope edit(LatencyMonitor::ModelEdit);
+    QPoint p = viewPending_ ? pendingCursor_ : QPoint(cursor_->x() - edge_.x(), cursor_->y() - edge_.y());
+    int x = p.x();
+    int y = p.y();
     QPoint pos = curPos_;
 
     if(event->matches(QKeySequence::Copy))
@@ -174,10 +314,12 @@ void TextField::keyPressEvent(QKeyEvent *event)
         cut();
     else if(event->matches(QKeySequence::Paste)){
         paste();
+        LatencyMonitor::instance().inputHandled(stamp);
         return;
     }
     else if(event->matches(QKeySequence::SelectAll)){
         selectAll();
+        LatencyMonitor::instance().inputHandled(stamp);
         return;
     }
     else if(event->key() == Qt::Key_Return)
@@ -191,6 +333,7 @@ void TextField::keyPressEvent(QKeyEvent *event)
                (event->key() >= 0x410 && event->key() <= 0x42f) ||
                (event->key() == 1000021))
         {
+            UndoGroup group(_selection_group());
             if(isSelected())
                 _erase_highlighted_text();
 
@@ -206,84 +349,100 @@ void TextField::keyPressEvent(QKeyEvent *event)
             textLines_->insert(curPos_.x(), curPos_.y(), Symbol(font(), in_char));
             p = textLines_->getShiftByPos(curPos_.x() + 1, curPos_.y(), pos);
         }
-        else if(event->matches(QKeySequence::MoveToNextChar))
-                    p = textLines_->getShiftByPos(curPos_.x() + 1, getCurPosY(), pos);
-        else if(event->matches(QKeySequence::MoveToEndOfLine))
-            p = textLines_->getShiftByPos((*textLines_)[curPos_.y()].size(), curPos_.y(), pos);
-        else if(event->matches(QKeySequence::MoveToPreviousChar))
-            p = textLines_->getShiftByPos(curPos_.x() - 1, getCurPosY(), pos);
-        else if(event->matches(QKeySequence::MoveToStartOfLine))
-            p = textLines_->getShiftByPos(0, curPos_.y(), pos);
-        else if(event->matches(QKeySequence::MoveToNextLine)){
-            if(curPos_.y() != textLines_->length() - 1){
-                pos = QPoint(curPos_.x(), curPos_.y() + 1 >= textLines_->length() ?
-                              textLines_->length() - 1 :
-                                curPos_.y() + 1);
-                x = (*textLines_)[pos.y()].getSymbolBegin(x, pos);
-                y = (*textLines_).getLineShift(pos.y(), pos.x());
-                p = QPoint(x, y);
+        else{
+            if(event->matches(QKeySequence::MoveToNextChar))
+                p = textLines_->getShiftByPos(curPos_.x() + 1, getCurPosY(), pos);
+            else if(event->matches(QKeySequence::MoveToEndOfLine))
+                p = textLines_->getShiftByPos(textLines_->at(curPos_.y()).size(), curPos_.y(), pos);
+            else if(event->matches(QKeySequence::MoveToPreviousChar))
+                p = textLines_->getShiftByPos(curPos_.x() - 1, getCurPosY(), pos);
+            else if(event->matches(QKeySequence::MoveToStartOfLine))
+                p = textLines_->getShiftByPos(0, curPos_.y(), pos);
+            else if(event->matches(QKeySequence::MoveToNextLine)){
+                if(curPos_.y() != textLines_->length() - 1){
+                    pos = QPoint(curPos_.x(), curPos_.y() + 1 >= textLines_->length() ?
+                                  textLines_->length() - 1 :
+                                    curPos_.y() + 1);
+                    x = textLines_->at(pos.y()).getSymbolBegin(x, pos);
+                    y = textLines_->getLineShift(pos.y(), pos.x());
+                    p = QPoint(x, y);
+                }
             }
+            else if(event->matches(QKeySequence::MoveToPreviousLine)){
+                pos = QPoint(curPos_.x(), curPos_.y() - 1 <= 0 ? 0 : curPos_.y() - 1);
+                p = QPoint(textLines_->at(pos.y()).getSymbolBegin(x, pos),
+                           textLines_->getLineShift(pos.y(), pos.x()));
+            }
+            else if(event->matches(QKeySequence::MoveToStartOfDocument))
+                p = textLines_->getShiftByPos(0, 0, pos);
+            else if(event->matches(QKeySequence::MoveToEndOfDocument)) {
+                p = textLines_->getShiftByPos(textLines_->at(textLines_->length() - 1).size(),
+                        textLines_->length(), pos);
+            }
+            else
+                return;
+            _seal_history();
         }
-        else if(event->matches(QKeySequence::MoveToPreviousLine)){
-            pos = QPoint(curPos_.x(), curPos_.y() - 1 <= 0 ? 0 : curPos_.y() - 1);
-            p = QPoint((*textLines_)[pos.y()].getSymbolBegin(x, pos),
-                       (*textLines_).getLineShift(pos.y(), pos.x()));
-        }
-        else if(event->matches(QKeySequence::MoveToStartOfDocument))
-            p = textLines_->getShiftByPos(0, 0, pos);
-        else if(event->matches(QKeySequence::MoveToEndOfDocument)) {
-            p = textLines_->getShiftByPos((*textLines_)[(*textLines_).length() - 1].size(),
-                    (*textLines_).length(), pos);
-        }
-        else
-            return;
         setCurrentPos(pos);
      }
-     _set_cursor_points(p);
-     resize_field(textLines_->width(), textLines_->height());
-     scrollViewport(curPos_);
+     _defer_view(p);
+     LatencyMonitor::instance().inputHandled(stamp);
 }
 
 void TextField::mouseMoveEvent(QMouseEvent * event)
 {
-    QPoint pos = curPos_;
-    QPoint p = textLines_->getShiftByCoord(QPoint(event->x() - edge_.x(), event->y() - edge_.y()),
-                                           pos);
-    setCurrentPos(pos);
-
-    _change_cursor(p);
-    _set_selection_end(QPoint(p.x(), (*textLines_).getLineRoof(getCurPosY())));
-    setSelected(true);
+    dragPoint_ = QPoint(event->x() - edge_.x(), event->y() - edge_.y());
+    if(!dragPending_){
+        dragPending_ = true;
+        dragStamp_ = LatencyMonitor::now();
+        if(!frameTimer_->isActive())
+            frameTimer_->start();
+    }
 }
 
 void TextField::mousePressEvent(QMouseEvent * event)
 {
+    qint64 stamp = LatencyMonitor::now();
+    _flush_view();
     if(event->button() == Qt::MouseButton::LeftButton){
+        _seal_history();
         QPoint pos = curPos_;
         QPoint curPoint = QPoint(event->x() - edge_.x(), event->y() - edge_.y());
         QPoint p = textLines_->getShiftByCoord(curPoint, pos);
         setCurrentPos(pos);
         _set_cursor_points(p);
+        LatencyMonitor::instance().inputHandled(stamp);
     }
 }
 
-void TextField::paintEvent(QPaintEvent *)
+void TextField::paintEvent(QPaintEvent *event)
 {
+    ALLOC_SCOPE(Paint);
+    qint64 begin = LatencyMonitor::now();
     QPainter painter(viewport());
+    QRect visible = viewport()->visibleRegion().boundingRect();
+    firstVisible_ = textLines_->lineAt(visible.top() - edge_.y());
+    lastVisible_ = textLines_->lineAt(visible.bottom() - edge_.y());
+    int first = textLines_->lineAt(event->rect().top() - edge_.y());
+    int last = textLines_->lineAt(event->rect().bottom() - edge_.y());
+    highlighter_->highlight(lastVisible_, Highlighter::PAINT_BUDGET);
     if(selectionBegin_ != selectionEnd_)
     {
         const QPoint& beginSelect = minPoint(selectionBegin_, selectionEnd_);
         const QPoint& endSelect = maxPoint(selectionBegin_, selectionEnd_);
-        _fill_highlightning_rect(painter, beginSelect, endSelect);
+        _fill_highlightning_rect(painter, beginSelect, endSelect, first, last);
         cursor_->draw(&painter, true);
     }
     else
         cursor_->draw(&painter, false);
-    width = textLines_->draw(&painter, curPos_, edge_);
+    width = textLines_->draw(&painter, curPos_, edge_, highlighter_, first, last);
+    LatencyMonitor::instance().framePainted(begin);
+    StartupProfiler::instance().framePainted();
 }
 
 void TextField::resizeEvent(QResizeEvent *)
 {
+    TRACE_SCOPE("TextField::resizeEvent");
     static int width = 0;
     static int height = 0;
 
@@ -322,9 +481,9 @@ void TextField::resizeEvent(QResizeEvent *)
 
 int TextField::getCurPosX() const
 {
-    if((*textLines_)[curPos_.y()].isEmpty())
+    if(textLines_->at(curPos_.y()).isEmpty())
         return 0;
-    return curPos_.x() == (*textLines_)[curPos_.y()].length() ?
+    return curPos_.x() == textLines_->at(curPos_.y()).length() ?
             curPos_.x() - 1 :
             curPos_.x();
 }
@@ -336,51 +495,135 @@ int TextField::getCurPosY() const
 
 void TextField::setCurrentPos(const QPoint& curPos) {
     curPos_ = curPos;
+    textLines_->setActiveLine(curPos_.y());
     emit posChanged(curPos_);
 }
 
+QPoint TextField::getSelectionStart() const
+{
+    return isSelected() ? minPoint(curPos_, selectionPos_) : curPos_;
+}
+
+void TextField::select(const QPoint &begin, const QPoint &end)
+{
+    _flush_view();
+    QPoint pos;
+    QPoint p = textLines_->getShiftByPos(begin.x(), begin.y(), pos);
+    setCurrentPos(pos);
+    _set_cursor_points(p);
+
+    p = textLines_->getShiftByPos(end.x(), end.y(), pos);
+    setCurrentPos(pos);
+    _change_cursor(p);
+    _set_selection_end(QPoint(p.x(), textLines_->getLineRoof(getCurPosY())));
+    setSelected(true);
+    scrollViewport(curPos_);
+    viewport()->update();
+}
+
+int TextField::replaceAll(const SearchMatches &matches, const QString &text)
+{
+    int count = textLines_->replace(matches, text);
+    if(count)
+        _reset_view_to(matches.first().begin());
+    return count;
+}
+
 void TextField::copy()
 {
-    textLines_->copyPart(textBuffer_,
-                minPoint(curPos_, selectionPos_),
-                maxPoint(curPos_, selectionPos_));
+    _flush_view();
+    TextSnapshot slice = textLines_->slice(minPoint(curPos_, selectionPos_),
+                                           maxPoint(curPos_, selectionPos_));
+    QGuiApplication::clipboard()->setMimeData(new SliceMimeData(slice, textLines_));
 }
 
 void TextField::cut()
 {
-    textLines_->cutPart(textBuffer_,
-                minPoint(curPos_, selectionPos_),
-                maxPoint(curPos_, selectionPos_));
+    _flush_view();
+    TextSnapshot slice = textLines_->cutPart(minPoint(curPos_, selectionPos_),
+                                             maxPoint(curPos_, selectionPos_));
+    QGuiApplication::clipboard()->setMimeData(new SliceMimeData(slice, textLines_));
     setCurrentPos(minPoint(curPos_, selectionPos_));
     _set_cursor_points(textLines_->getShiftByPos(curPos_.x(), curPos_.y(), curPos_));
 }
 
 void TextField::paste()
 {
+    ALLOC_SCOPE(Paste);
+    _flush_view();
+    const QMimeData *data = QGuiApplication::clipboard()->mimeData();
+    if(!data)
+        return;
+    if(const SliceMimeData *own = qobject_cast<const SliceMimeData*>(data)){
+        _insert_slice(own->slice());
+        return;
+    }
+
+    QByteArray styled = data->hasFormat(SliceMimeData::STYLED_FORMAT) ?
+                data->data(SliceMimeData::STYLED_FORMAT) : QByteArray();
+    QString plain = styled.isEmpty() && data->hasText() ? data->text() : QString();
+    QFont f = font();
+    ArenaRef arena = textLines_->arena();
+    if(styled.size() + plain.size() < PASTE_ASYNC_SIZE){
+        _insert_slice(SliceMimeData::decode(styled, plain, f, arena));
+        return;
+    }
+
+    pasteJob_.cancel();
+    QSharedPointer<TextSnapshot> result(new TextSnapshot);
+    pasteJob_ = JobPool::instance().submit(JobPool::Interactive, [result, styled, plain, f, arena](const CancelToken&) {
+        *result = SliceMimeData::decode(styled, plain, f, arena);
+    }, this, [this, result]() {
+        ALLOC_SCOPE(Paste);
+        _insert_slice(*result);
+    });
+}
+
+void TextField::_insert_slice(const TextSnapshot &slice)
+{
+    if(slice.isNull())
+        return;
+    UndoGroup group(_selection_group());
     if(isSelected())
         _erase_highlighted_text();
     QPoint pos = curPos_;
-    textLines_->insertPart(textBuffer_, pos);
-    int x = (*textLines_)[curPos_.y()].getSymbShift(pos.x());
+    textLines_->insertPart(slice, pos);
+    int x = textLines_->at(pos.y()).getSymbShift(pos.x());
     int y = textLines_->getLineShift(pos.y(), pos.x());
     setCurrentPos(pos);
     _set_cursor_points(QPoint(x, y));
 }
 
+void TextField::undo()
+{
+    QPoint pos;
+    if(textLines_->undo(pos))
+        _reset_view_to(pos);
+}
+
+void TextField::redo()
+{
+    QPoint pos;
+    if(textLines_->redo(pos))
+        _reset_view_to(pos);
+}
+
 void TextField::selectAll()
 {
+    _flush_view();
     setSelected(true);
     selectionBegin_ = QPoint(0, 0);
     selectionEnd_ = _get_end_document();
     selectionPos_ = QPoint(0, 0);
-    _change_cursor((*textLines_).getShiftByPos(
-                        (*textLines_)[textLines_->length() - 1].length(),
+    _change_cursor(textLines_->getShiftByPos(
+                        textLines_->at(textLines_->length() - 1).length(),
                         textLines_->length() - 1,
                         curPos_));
 }
 
 void TextField::resize_field(qint64 w, qint64 h)
 {
+    TRACE_SCOPE("TextField::resize_field");
     if(w + 2 * edge_.x() + verticalScrollBar()->height() < size().width())
         w = size().width();
     else
@@ -392,9 +635,49 @@ void TextField::resize_field(qint64 w, qint64 h)
     field_->setFixedSize(w, h);
 }
 
+qint64 TextField::_document_width() const
+{
+    return qMax<qint64>(documentWidth_, textLines_->at(curPos_.y()).getWidth());
+}
+
+// Measures every line from scratch in idle slices. Only needed when the
+// document may have become narrower; see on_lines_changed().
+void TextField::_schedule_measure()
+{
+    measureLine_ = 0;
+    measureWidest_ = 0;
+    measureWidestLine_ = -1;
+    if(measuring_)
+        return;
+    measuring_ = true;
+    IdleScheduler::instance().post(this, MeasureTask, IdleScheduler::HighPriority,
+                                   [this](const IdleDeadline& deadline) { return _measure_slice(deadline); });
+}
+
+bool TextField::_measure_slice(const IdleDeadline &deadline)
+{
+    LatencyScope metrics(LatencyMonitor::Metrics);
+    while(measureLine_ < textLines_->length()){
+        qint64 width = textLines_->at(measureLine_).getWidth();
+        if(width > measureWidest_){
+            measureWidest_ = width;
+            measureWidestLine_ = measureLine_;
+        }
+        if(!(++measureLine_ % 1024) && deadline.expired())
+            return false;
+    }
+    measuring_ = false;
+    widestLine_ = measureWidestLine_;
+    if(measureWidest_ != documentWidth_){
+        documentWidth_ = measureWidest_;
+        resize_field(documentWidth_, textLines_->height());
+    }
+    return true;
+}
+
 QPoint TextField::_get_end_document()
 {
-    Line* lasLine = &(*textLines_)[textLines_->length() - 1];
+    const Line* lasLine = &textLines_->at(textLines_->length() - 1);
     return QPoint(lasLine->getWidth(), textLines_->height() - lasLine->height());
 }
 
@@ -413,16 +696,84 @@ QPoint TextField::_handle_backspace()
 
 QPoint TextField::_handle_enter()
 {
+    UndoGroup group(_selection_group());
     if(isSelected())
         _erase_highlighted_text();
-    Line line = (*textLines_)[getCurPosY()].getNewLine(curPos_.x());
-    setCurrentPos(QPoint(0, curPos_.y() + 1));
-    textLines_->insert(getCurPosY(), line);
-    return QPoint((*textLines_)[curPos_.y()].getSymbShift(getCurPosX()),
-            (*textLines_).getLineShift(getCurPosY(), getCurPosX()));
+    QPoint pos = curPos_;
+    textLines_->breakLine(pos);
+    setCurrentPos(pos);
+    return QPoint(textLines_->at(curPos_.y()).getSymbShift(getCurPosX()),
+            textLines_->getLineShift(getCurPosY(), getCurPosX()));
+}
+
+void TextField::_reset_view_to(QPoint pos)
+{
+    viewPending_ = false;
+    frameTimer_->stop();
+    setSelected(false);
+    setCurrentPos(pos);
+    _set_cursor_points(textLines_->getShiftByPos(curPos_.x(), curPos_.y(), curPos_));
+    resize_field(_document_width(), textLines_->height());
+    scrollViewport(curPos_);
+    viewport()->update();
 }
 
-void TextField::_fill_highlightning_rect(QPainter &painter, const QPoint &begin, const QPoint &end)
+void TextField::_defer_view(QPoint p)
+{
+    pendingCursor_ = p;
+    _set_selection_pos(curPos_);
+    if(!viewPending_){
+        viewPending_ = true;
+        if(!frameTimer_->isActive())
+            frameTimer_->start();
+    }
+}
+
+void TextField::_flush_view()
+{
+    if(viewPending_){
+        viewPending_ = false;
+        frameTimer_->stop();
+        {
+            LatencyScope metrics(LatencyMonitor::Metrics);
+            _set_cursor_points(pendingCursor_);
+        }
+        {
+            LatencyScope layout(LatencyMonitor::Layout);
+            resize_field(_document_width(), textLines_->height());
+            scrollViewport(curPos_);
+        }
+        viewport()->update();
+    }
+    _flush_drag();
+}
+
+void TextField::_flush_drag()
+{
+    if(!dragPending_)
+        return;
+    dragPending_ = false;
+    frameTimer_->stop();
+    int previous = curPos_.y();
+    QPoint pos = curPos_;
+    QPoint p = textLines_->getShiftByCoord(dragPoint_, pos);
+    setCurrentPos(pos);
+
+    _change_cursor(p);
+    _set_selection_end(QPoint(p.x(), textLines_->getLineRoof(getCurPosY())));
+    setSelected(true);
+
+    // Only the lines between the old and the new selection end change highlight.
+    int first = qMin(previous, curPos_.y());
+    int last = qMax(previous, curPos_.y());
+    int top = textLines_->getLineRoof(first) + edge_.y();
+    int bottom = textLines_->getLineRoof(last) + textLines_->at(last).height() + edge_.y();
+    viewport()->update(QRect(0, top, viewport()->width(), bottom - top));
+    LatencyMonitor::instance().inputHandled(dragStamp_);
+}
+
+void TextField::_fill_highlightning_rect(QPainter &painter, const QPoint &begin, const QPoint &end,
+                                         int first, int last)
 {
     int  beginPos = selectionPos_.y() < curPos_.y() ?
                 selectionPos_.y() :
@@ -432,42 +783,28 @@ void TextField::_fill_highlightning_rect(QPainter &painter, const QPoint &begin,
                 curPos_.y();
 
     if(beginPos < endPos){
-        int xBegin = begin.x() + edge_.x();
-        int yBegin = begin.y() + edge_.y();
-        int xEnd = (*textLines_)[beginPos].getWidth() + edge_.x() + 5;
-        int yEnd = begin.y() + (*textLines_)[beginPos].height() + edge_.y();
-        painter.fillRect(QRect(QPoint(xBegin, yBegin), QPoint(xEnd, yEnd)),
-                         highlightningColor_);
-
-        xBegin = edge_.x();
-        int yPos = beginPos + 1;
-        for(; yPos < endPos; ++yPos)
+        int from = qMax(beginPos, first);
+        int to = qMin(endPos, last);
+        int yEnd = textLines_->getLineRoof(from) + edge_.y();
+        for(int yPos = from; yPos <= to; ++yPos)
         {
-            yBegin = yEnd;
-            yEnd += (*textLines_)[yPos].height();
-            if((*textLines_)[yPos].isEmpty())
-            {
-                painter.fillRect(QRect(QPoint(xBegin, yBegin), QPoint(10, yEnd)),
-                                 highlightningColor_);
-                continue;
-            }
-            xEnd = (*textLines_)[yPos].getWidth() + edge_.x() + 5;
-
-            painter.fillRect(QRect(QPoint(xBegin, yBegin),
-                                   QPoint(xEnd, yEnd)),
+            const Line& line = textLines_->at(yPos);
+            int yBegin = yEnd;
+            yEnd += line.height();
+            int xBegin = yPos == beginPos ? begin.x() + edge_.x() : edge_.x();
+            int xEnd = line.getWidth() + edge_.x() + 5;
+            if(yPos == endPos)
+                xEnd = end.x() + edge_.x();
+            else if(yPos != beginPos && line.isEmpty())
+                xEnd = 10;
+
+            painter.fillRect(QRect(QPoint(xBegin, yBegin), QPoint(xEnd, yEnd)),
                              highlightningColor_);
         }
-
-        yBegin = yEnd;
-        xEnd = end.x() + edge_.x();
-        yEnd += (*textLines_)[yPos].height();
-        painter.fillRect(QRect(QPoint(xBegin, yBegin),
-                           QPoint(xEnd, yEnd)),
-                           highlightningColor_);
     }
     else{
         painter.fillRect(QRect(QPoint(begin.x() + edge_.x(), begin.y() + edge_.y()),
-                               QPoint(end.x() + edge_.x(), end.y() + edge_.y() + (*textLines_)[beginPos].height())),
+                               QPoint(end.x() + edge_.x(), end.y() + edge_.y() + textLines_->at(beginPos).height())),
                          highlightningColor_);
     }
 }
@@ -498,6 +835,19 @@ void TextField::_erase_highlighted_text()
     setSelected(false);
 }
 
+// Replacing a selection is one undo step; plain typing is left to coalesce.
+UndoStack *TextField::_selection_group() const
+{
+    return isSelected() ? textLines_->undoStack() : Q_NULLPTR;
+}
+
+// Moving the caret ends the current run of typing.
+void TextField::_seal_history()
+{
+    if(textLines_->undoStack())
+        textLines_->undoStack()->seal();
+}
+
 const QPoint& TextField::minPoint(const QPoint &p1, const QPoint &p2) const
 {
     if(p1.y() < p2.y() )
@@ -528,12 +878,12 @@ void TextField::_set_cursor_points(QPoint p)
 {
     _change_cursor(p);
 
-    QPoint p_roof = QPoint(p.x(), (*textLines_).getLineRoof(getCurPosY()));
+    QPoint p_roof = QPoint(p.x(), textLines_->getLineRoof(getCurPosY()));
     _set_selection_pos(curPos_);
     _set_selection_begin(p_roof);
     _set_selection_end(p_roof);
-    if(!(*textLines_)[getCurPosY()].isEmpty()){
-        setFont(QFont((*textLines_)[getCurPosY()][curPos_.x() ? curPos_.x() - 1 : 0].font()));
+    if(!textLines_->at(getCurPosY()).isEmpty()){
+        setFont(QFont(textLines_->at(getCurPosY())[curPos_.x() ? curPos_.x() - 1 : 0].font()));
         emit fontChanged(font());
     }
 }
@@ -542,7 +892,7 @@ void TextField::_change_cursor(QPoint p)
 {
     int y = getCurPosY();
     int x = getCurPosX();
-    cursor_->setCursor(p, (*textLines_)[y].isEmpty() ?
-                           (*textLines_)[y].height() :
-                           (*textLines_)[y][x].height());
+    cursor_->setCursor(p, textLines_->at(y).isEmpty() ?
+                           textLines_->at(y).height() :
+                           textLines_->at(y)[x].height());
 }
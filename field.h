@@ -5,6 +5,14 @@
 
 #include "char.h"
 #include "carriage.h"
+#include "search.h"
+#include "highlighter.h"
+#include "scheduler.h"
+#include "latency.h"
+#include "startup.h"
+#include "undo.h"
+#include "allocprofile.h"
+#include "clipboard.h"
 
 class TextField : public QAbstractScrollArea
 {
@@ -22,6 +30,10 @@ public:
 
     inline const Text* getText() const { return textLines_; }
     void setText(const Text* text);
+    void appendText(const TextSnapshot& lines);
+
+    inline const SyntaxDefinition *syntax() const { return highlighter_->definition(); }
+    void setSyntax(const SyntaxDefinition *definition);
 
     inline bool capsLock() const { return capsPressed_; }
     inline void setCapsLock(const bool caps) { capsPressed_ = caps; }
@@ -32,12 +44,23 @@ public:
     inline int getCurPosX() const;
     inline int getCurPosY() const;
     void setCurrentPos(const QPoint& curPos);
+    inline const QPoint& getCurrentPos() const { return curPos_; }
+    QPoint getSelectionStart() const;
+    void select(const QPoint& begin, const QPoint& end);
+    int replaceAll(const SearchMatches& matches, const QString& text);
 
     void copy();
     void cut();
     void paste();
+    void undo();
+    void redo();
     void selectAll();
 
+    MemoryUsage memoryUsage() const;
+
+    inline bool isLatencyHudVisible() const { return hud_->isVisible(); }
+    void setLatencyHudVisible(bool visible);
+
 public slots:
     void changeCurrentFontSize(const QString &font);
     void changeCurrentFont(const QString &font);
@@ -51,14 +74,21 @@ signals:
     void posChanged(QPoint);
     void fontChanged(const QFont&);
 
+private slots:
+    void on_highlight_changed(int first, int last);
+    void on_lines_changed(int line, int removed, int added);
+    void on_frame_timer();
+
 protected:
     void keyPressEvent(QKeyEvent *);
     void mousePressEvent(QMouseEvent *);
     void mouseMoveEvent(QMouseEvent *);
-    void paintEvent(QPaintEvent *);
+    void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *);
 
 private:
+    enum { MeasureTask };
+    enum { FRAME_INTERVAL = 16, HUD_MARGIN = 8, PASTE_ASYNC_SIZE = 1 << 20 };
 
     template <class T>
     using textFunc = void (Text::*) (Text::qFontF<T> f, QPoint, QPoint, T);
@@ -66,10 +96,13 @@ private:
     template <class Argument>
     void apply_font_func(Text::qFontF<Argument> ff, Argument arg)
     {
+        ALLOC_SCOPE(FontChange);
+        _flush_view();
         if(selectionBegin_ != selectionEnd_){
             QPoint min_point = minPoint(curPos_, selectionPos_);
             QPoint max_point = maxPoint(curPos_, selectionPos_);
             textLines_->fontF<Argument>(ff, min_point, max_point, arg);
+            resize_field(_document_width(), textLines_->height());
             _set_selection_begin((*textLines_).getShiftByPos(min_point.x(), min_point.y(), curPos_));
             _set_selection_end((*textLines_).getShiftByPos(max_point.x(), max_point.y(), curPos_));
             _change_cursor(selectionEnd_);
@@ -78,17 +111,29 @@ private:
 
 
     void resize_field(qint64 w, qint64 h);
+    inline qint64 _document_width() const;
+    void _schedule_measure();
+    bool _measure_slice(const IdleDeadline& deadline);
+    static bool _fold_width(qint64& width, int& widestLine, int line, int removed, int added,
+                            qint64 widest, int widestAt);
     inline QPoint _get_end_document();
     inline void _change_positions(QPoint p);
 
     inline QPoint _handle_backspace();
     inline QPoint _handle_enter();
+    void _reset_view_to(QPoint pos);
+    void _defer_view(QPoint p);
+    void _flush_view();
+    void _flush_drag();
+    void _insert_slice(const TextSnapshot& slice);
 
-    void _fill_highlightning_rect(QPainter &painter, const QPoint&, const QPoint&);
+    void _fill_highlightning_rect(QPainter &painter, const QPoint&, const QPoint&, int first, int last);
     inline void _set_selection_begin(QPoint);
     inline void _set_selection_end(QPoint);
     inline void _set_selection_pos(QPoint);
     inline void _erase_highlighted_text();
+    inline UndoStack *_selection_group() const;
+    void _seal_history();
     inline const QPoint& minPoint(const QPoint&, const QPoint&) const;
     inline const QPoint& maxPoint(const QPoint&, const QPoint&) const;
     inline void _reset_selection();
@@ -102,7 +147,25 @@ private:
     Cursor* cursor_;
 
     Text* textLines_;
-    Text* textBuffer_;
+    Highlighter *highlighter_;
+    int firstVisible_;
+    int lastVisible_;
+
+    qint64 documentWidth_;
+    int widestLine_;
+    bool measuring_;
+    int measureLine_;
+    qint64 measureWidest_;
+    int measureWidestLine_;
+
+    LatencyHud *hud_;
+    QTimer *frameTimer_;
+    QPoint pendingCursor_;
+    bool viewPending_;
+    QPoint dragPoint_;
+    bool dragPending_;
+    qint64 dragStamp_;
+    JobHandle pasteJob_;
 
     QPoint curPos_;
     bool capsPressed_;
@@ -1,5 +1,7 @@
 #include "filerecord.h"
 
+#include <limits>
+
 FileRecord::FileRecord(QObject *parent):
     QObject(parent)
 {
@@ -7,136 +9,181 @@ FileRecord::FileRecord(QObject *parent):
 
 Text* FileRecord::read(QString file, QFont defFont)
 {
-    QFile inFile(file);
+    TRACE_SCOPE("FileRecord::read");
+    open(file, defFont);
+    return readLines(std::numeric_limits<int>::max());
+}
 
+void FileRecord::open(QString file, QFont defFont)
+{
+    inFile.close();
+    inFile.setFileName(file);
     if(!inFile.open(QIODevice::ReadOnly))
         throw FileOpenException();
 
-    Text *text = new Text();
-
-    if(file.endsWith(".xml"))
-    {
-        reader.setDevice(&inFile);
-        reader.readNext();
-        reader.readNext();
-        reader.readNext();
-        do{
-            Line line = Line(reader.attributes()[0].value().toInt(), text);
-            reader.readNext();
-
-            do{
-                QXmlStreamAttributes attrs = reader.attributes();
-                reader.readNext();
-                if(reader.isEndElement() && reader.name().toString() == "font"){
-                    reader.readNext();
-                    break;
-                }
-                QString str = reader.text().toString();
-                add_similar_font_text(attrs, str, line);
-
-                reader.readNext();
-                reader.readNext();
-                if(reader.isEndElement() && reader.name().toString() == "line")
-                    break;
-            } while(true);
-
-            text->push_back(line);
-
-            reader.readNext();
-        } while(!(reader.isEndElement() && reader.name().toString() == "Text"));
-    }
-    else if(file.endsWith(".txt"))
-    {
-        int height = QFontMetrics(defFont).height();
-        bool endsWithEmpty = true;
-        QTextCodec* codec = QTextCodec::codecForName("UTF-8");
-        QTextCodec::setCodecForLocale(codec);
-
-        while(!inFile.atEnd())
-        {
-            Line line = Line(height, text);
-            QByteArray byteLine = inFile.readLine();
-            QString t;
-            if(byteLine.endsWith('\n')){
-                byteLine.remove(byteLine.length() - 1, 1);
-                endsWithEmpty = true;
-            }
-            else endsWithEmpty = false;
-            t = codec->toUnicode(byteLine);
-            foreach (const QChar& s, t) {
+    isXml = file.endsWith(".xml");
+    endsWithEmpty = true;
+    lineHeight = QFontMetrics(defFont).height();
+    lineStyle = FontTable::instance().intern(defFont);
+    codec = QTextCodec::codecForName("UTF-8");
+    if(isXml)
+        read_xml_start(&inFile);
+}
 
-                line.push_back(Symbol(defFont, s));
-            }
-            text->push_back(line);
-        }
-        if(endsWithEmpty)
-            text->push_back(Line(height, text));
-    }
-    inFile.close();
+Text* FileRecord::readLines(int count, const ArenaRef& arena)
+{
+    TRACE_SCOPE("FileRecord::readLines");
+    ALLOC_SCOPE(Load);
+    Text *text = new Text(arena);
+    bool finished = isXml ? read_xml_lines(text, count) : read_plain_lines(text, count);
+    if(finished)
+        inFile.close();
     return text;
 }
 
 bool FileRecord::write(const Text* text, QString file)
 {
+    return write(text->snapshot(), file);
+}
+
+bool FileRecord::write(const TextSnapshot& text, QString file)
+{
+    TRACE_SCOPE("FileRecord::write");
+    ALLOC_SCOPE(Save);
     QFile outFile(file);
 
     if(!outFile.open(QIODevice::WriteOnly))
         return false;
 
     if(file.endsWith(".xml"))
+        writeXml(text, &outFile);
+    else
+        writePlain(text, &outFile);
+    outFile.close();
+    return true;
+}
+
+void FileRecord::readXml(QIODevice *device, Text *text)
+{
+    read_xml_start(device);
+    read_xml_lines(text, std::numeric_limits<int>::max());
+}
+
+void FileRecord::writeXml(const TextSnapshot& text, QIODevice *device)
+{
+    writer.setDevice(device);
+    writer.writeStartDocument();
+    QFont curFont;
+    QString simText;
+    writer.writeStartElement(QString("Text"));
+    for(int i = 0; i < text.length(); ++i)
     {
-        writer.setDevice(&outFile);
-        writer.writeStartDocument();
-        QFont curFont;
-        QString simText;
-        writer.writeStartElement(QString("Text"));
-        for(int i = 0; i < text->length(); ++i)
-        {
-            writer.writeStartElement(QString("line"));
-            writer.writeAttribute(QString("height"), QString(QString::number(text->at(i).height())));
+        writer.writeStartElement(QString("line"));
+        writer.writeAttribute(QString("height"), QString(QString::number(text.at(i).height())));
 
-            if(!text->at(i).isEmpty())
-                curFont = text->at(i).at(0).font();
+        if(!text.at(i).isEmpty())
+            curFont = text.at(i).at(0).font();
 
-            writer.writeStartElement(QString("font"));
-            add_font_attrs(curFont);
+        writer.writeStartElement(QString("font"));
+        add_font_attrs(curFont);
 
-            for(int j = 0; j < text->at(i).length(); ++j)
+        for(int j = 0; j < text.at(i).length(); ++j)
+        {
+            if(curFont != text.at(i).at(j).font())
             {
-                if(curFont != text->at(i).at(j).font())
-                {
-                    writer.writeCharacters(simText);
-                    writer.writeEndElement();
-                    simText = QString();
-
-                    curFont = text->at(i).at(j).font();
-                    writer.writeStartElement(QString("font"));
-                    add_font_attrs(curFont);
-                }
-                simText += text->at(i).at(j).value();
+                writer.writeCharacters(simText);
+                writer.writeEndElement();
+                simText = QString();
+
+                curFont = text.at(i).at(j).font();
+                writer.writeStartElement(QString("font"));
+                add_font_attrs(curFont);
             }
-            writer.writeCharacters(simText);
-            simText = QString();
-            writer.writeEndElement();
-            writer.writeEndElement();
+            simText += text.at(i).at(j).value();
         }
+        writer.writeCharacters(simText);
+        simText = QString();
+        writer.writeEndElement();
         writer.writeEndElement();
-        writer.writeEndDocument();
     }
-    else if(file.endsWith(".txt"))
+    writer.writeEndElement();
+    writer.writeEndDocument();
+}
+
+void FileRecord::writePlain(const TextSnapshot& text, QIODevice *device)
+{
+    QTextStream outStream(device);
+    outStream.setCodec("UTF-8");
+    for(int i = 0; i < text.length() - 1; ++i)
     {
-        QTextStream outStream(&outFile);
-        for(int i = 0; i < text->length() - 1; ++i)
-        {
-            for(int j = 0; j < text->at(i).length(); ++j)
-                outStream << text->at(i).at(j).value();
-            outStream << '\n';
+        for(int j = 0; j < text.at(i).length(); ++j)
+            outStream << text.at(i).at(j).value();
+        outStream << '\n';
+    }
+    if(!text.at(text.length() - 1).isEmpty())
+        for(int j = 0; j < text.at(text.length() - 1).length(); ++j)
+            outStream << text.at(text.length() - 1).at(j).value();
+}
+
+void FileRecord::read_xml_start(QIODevice *device)
+{
+    reader.setDevice(device);
+    reader.readNext();
+    reader.readNext();
+    reader.readNext();
+}
+
+bool FileRecord::read_xml_lines(Text *text, int count)
+{
+    for(; count > 0; --count){
+        if(reader.atEnd() || (reader.isEndElement() && reader.name().toString() == "Text"))
+            return true;
+        Line line = Line(reader.attributes()[0].value().toInt(), text->arena());
+        reader.readNext();
+
+        do{
+            QXmlStreamAttributes attrs = reader.attributes();
+            reader.readNext();
+            if(reader.isEndElement() && reader.name().toString() == "font"){
+                reader.readNext();
+                break;
+            }
+            QString str = reader.text().toString();
+            add_similar_font_text(attrs, str, line);
+
+            reader.readNext();
+            reader.readNext();
+            if(reader.isEndElement() && reader.name().toString() == "line")
+                break;
+        } while(true);
+
+        text->push_back(line);
+
+        reader.readNext();
+    }
+    return reader.atEnd() || (reader.isEndElement() && reader.name().toString() == "Text");
+}
+
+bool FileRecord::read_plain_lines(Text *text, int count)
+{
+    for(; count > 0 && !inFile.atEnd(); --count)
+    {
+        Line line = Line(lineHeight, text->arena());
+        QByteArray byteLine = inFile.readLine();
+        if(byteLine.endsWith('\n')){
+            byteLine.remove(byteLine.length() - 1, 1);
+            endsWithEmpty = true;
         }
-        if(!text->at(text->length() - 1).isEmpty())
-            for(int j = 0; j < text->at(text->length() - 1).length(); ++j)
-                outStream << text->at(text->length() - 1).at(j).value();
+        else endsWithEmpty = false;
+        QString t = codec->toUnicode(byteLine);
+        for(int i = 0; i < t.size(); ++i)
+            line.push_back(Symbol(t.at(i), lineStyle));
+        text->push_back(line);
     }
-    outFile.close();
+    if(!inFile.atEnd())
+        return false;
+    if(endsWithEmpty)
+        text->push_back(Line(lineHeight, text->arena()));
     return true;
 }
 
@@ -158,7 +205,7 @@ void FileRecord::add_similar_font_text(QXmlStreamAttributes attributes, QString
     QFont font = QFont(family, size, -1, italic);
     font.setBold(bold);
 
-    foreach (QChar ch, text) {
-        line.push_back(Symbol(font, ch));
-    }
+    quint16 style = FontTable::instance().intern(font);
+    for(int i = 0; i < text.size(); ++i)
+        line.push_back(Symbol(text.at(i), style));
 }
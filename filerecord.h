@@ -1,9 +1,11 @@
 #ifndef FILERECORDE_H
 #define FILERECORDE_H
 
-#include <QtWidgets>
+#include <QtGui>
 
 #include "char.h"
+#include "trace.h"
+#include "allocprofile.h"
 
 class FileOpenException: public QException
 {
@@ -28,9 +30,20 @@ public:
     FileRecord(QObject *parent = Q_NULLPTR);
 
     Text *read(QString file, QFont defFont);
+    void open(QString file, QFont defFont);
+    Text *readLines(int count, const ArenaRef& arena = ArenaRef());
+    inline bool atEnd() const { return !inFile.isOpen(); }
     bool write(const Text *text, QString file);
+    bool write(const TextSnapshot& text, QString file);
+
+    void readXml(QIODevice *device, Text *text);
+    void writeXml(const TextSnapshot& text, QIODevice *device);
+    void writePlain(const TextSnapshot& text, QIODevice *device);
 
 private:
+    void read_xml_start(QIODevice *device);
+    bool read_xml_lines(Text *text, int count);
+    bool read_plain_lines(Text *text, int count);
     void add_font_attrs(const QFont& font);
     void add_similar_font_text(QXmlStreamAttributes, QString text, Line&);
 
@@ -38,6 +51,13 @@ private:
     QXmlStreamReader reader;
     QXmlStreamWriter writer;
 
+    QFile inFile;
+    QTextCodec *codec;
+    bool isXml;
+    bool endsWithEmpty;
+    int lineHeight;
+    quint16 lineStyle;
+
 };
 
 #endif
@@ -0,0 +1,81 @@
+#include "findbar.h"
+
+FindBar::FindBar(QWidget *parent)
+    : QToolBar(tr("Find"), parent)
+{
+    patternEdit = new QLineEdit(this);
+    replaceEdit = new QLineEdit(this);
+    caseBox = new QCheckBox(tr("Match case"), this);
+    regexBox = new QCheckBox(tr("Regex"), this);
+    countLabel = new QLabel(this);
+
+    createToolBar();
+}
+
+FindBar::~FindBar()
+{
+}
+
+SearchQuery FindBar::query() const
+{
+    SearchQuery query;
+    query.pattern = patternEdit->text();
+    query.cs = caseBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    query.regex = regexBox->isChecked();
+    return query;
+}
+
+void FindBar::activate()
+{
+    show();
+    patternEdit->setFocus();
+    patternEdit->selectAll();
+}
+
+void FindBar::setMatchCount(int count, bool finished)
+{
+    if(patternEdit->text().isEmpty())
+        countLabel->clear();
+    else if(finished)
+        countLabel->setText(tr("%1 matches").arg(count));
+    else
+        countLabel->setText(tr("%1 matches...").arg(count));
+}
+
+void FindBar::setInvalid()
+{
+    countLabel->setText(patternEdit->text().isEmpty() ? QString() : tr("Invalid pattern"));
+}
+
+void FindBar::setReplaced(int count)
+{
+    countLabel->setText(tr("%1 replaced").arg(count));
+}
+
+void FindBar::createToolBar()
+{
+    patternEdit->setPlaceholderText(tr("Find"));
+    addWidget(patternEdit);
+    addWidget(caseBox);
+    addWidget(regexBox);
+
+    QAction *previousAction = addAction(tr("Previous"));
+    QAction *nextAction = addAction(tr("Next"));
+    addSeparator();
+
+    replaceEdit->setPlaceholderText(tr("Replace"));
+    addWidget(replaceEdit);
+    QAction *replaceAllAction = addAction(tr("Replace All"));
+    addWidget(countLabel);
+
+    QAction *closeAction = addAction(tr("Close"));
+
+    connect(patternEdit, SIGNAL( textChanged(QString) ), SIGNAL( queryChanged() ) );
+    connect(caseBox, SIGNAL( toggled(bool) ), SIGNAL( queryChanged() ) );
+    connect(regexBox, SIGNAL( toggled(bool) ), SIGNAL( queryChanged() ) );
+    connect(patternEdit, SIGNAL( returnPressed() ), SIGNAL( findNext() ) );
+    connect(nextAction, SIGNAL( triggered() ), SIGNAL( findNext() ) );
+    connect(previousAction, SIGNAL( triggered() ), SIGNAL( findPrevious() ) );
+    connect(replaceAllAction, SIGNAL( triggered() ), SIGNAL( replaceAll() ) );
+    connect(closeAction, SIGNAL( triggered() ), SLOT( hide() ) );
+}
@@ -0,0 +1,42 @@
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#include <QtWidgets>
+
+#include "search.h"
+
+class FindBar : public QToolBar
+{
+    Q_OBJECT
+
+public:
+    explicit FindBar(QWidget *parent = Q_NULLPTR);
+    ~FindBar();
+
+    SearchQuery query() const;
+    inline QString replacement() const { return replaceEdit->text(); }
+
+public slots:
+    void activate();
+    void setMatchCount(int count, bool finished);
+    void setInvalid();
+    void setReplaced(int count);
+
+signals:
+    void queryChanged();
+    void findNext();
+    void findPrevious();
+    void replaceAll();
+
+protected:
+    void createToolBar();
+
+private:
+    QLineEdit *patternEdit;
+    QLineEdit *replaceEdit;
+    QCheckBox *caseBox;
+    QCheckBox *regexBox;
+    QLabel *countLabel;
+};
+
+#endif
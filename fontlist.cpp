@@ -0,0 +1,98 @@
+#include "fontlist.h"
+#include "trace.h"
+
+FontListModel::FontListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    loaded = false;
+}
+
+FontListModel::~FontListModel()
+{
+    loadJob.cancel();
+}
+
+int FontListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : families.size();
+}
+
+QVariant FontListModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= families.size())
+        return QVariant();
+    if(role == Qt::DisplayRole || role == Qt::EditRole)
+        return families.at(index.row());
+    return QVariant();
+}
+
+void FontListModel::load()
+{
+    if(loaded || !loadJob.isNull())
+        return;
+    QSharedPointer<QStringList> result(new QStringList);
+    loadJob = JobPool::instance().submit(JobPool::Background, [result](const CancelToken&) {
+        TRACE_SCOPE("FontListModel::load");
+        *result = QFontDatabase().families();
+    }, this, [this, result]() {
+        beginResetModel();
+        families = *result;
+        loaded = true;
+        endResetModel();
+        emit familiesLoaded();
+    });
+}
+
+FontPicker::FontPicker(FontListModel *model, QWidget *parent)
+    : QWidget(parent)
+{
+    this->model = model;
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter fonts"));
+    filterEdit->setClearButtonEnabled(true);
+
+    filterModel = new QSortFilterProxyModel(this);
+    filterModel->setSourceModel(model);
+    filterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+    listView = new QListView(this);
+    listView->setModel(filterModel);
+    listView->setUniformItemSizes(true);
+    listView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listView->setMinimumHeight(listView->fontMetrics().height() * VISIBLE_ROWS);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(2, 2, 2, 2);
+    layout->addWidget(filterEdit);
+    layout->addWidget(listView);
+
+    connect(filterEdit, SIGNAL( textChanged(QString) ), filterModel, SLOT( setFilterFixedString(QString) ) );
+    connect(filterEdit, SIGNAL( returnPressed() ), SLOT( chooseFirst() ) );
+    connect(listView, SIGNAL( clicked(QModelIndex) ), SLOT( chooseIndex(QModelIndex) ) );
+    connect(listView, SIGNAL( activated(QModelIndex) ), SLOT( chooseIndex(QModelIndex) ) );
+}
+
+FontPicker::~FontPicker()
+{
+}
+
+void FontPicker::showEvent(QShowEvent *)
+{
+    model->load();
+    filterEdit->clear();
+    filterEdit->setFocus();
+}
+
+void FontPicker::chooseIndex(const QModelIndex &index)
+{
+    // Single-click activation styles deliver both clicked and activated;
+    // the first one closes the menu.
+    if(!isVisible() || !index.isValid())
+        return;
+    emit fontChosen(index.data().toString());
+}
+
+void FontPicker::chooseFirst()
+{
+    chooseIndex(filterModel->index(0, 0));
+}
@@ -0,0 +1,60 @@
+#ifndef FONTLIST_H
+#define FONTLIST_H
+
+#include <QtWidgets>
+
+#include "jobs.h"
+
+class FontListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit FontListModel(QObject *parent = Q_NULLPTR);
+    ~FontListModel();
+
+    inline bool isLoaded() const { return loaded; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+public slots:
+    void load();
+
+signals:
+    void familiesLoaded();
+
+private:
+    QStringList families;
+    JobHandle loadJob;
+    bool loaded;
+};
+
+class FontPicker : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FontPicker(FontListModel *model, QWidget *parent = Q_NULLPTR);
+    ~FontPicker();
+
+signals:
+    void fontChosen(const QString &family);
+
+protected:
+    void showEvent(QShowEvent *);
+
+private slots:
+    void chooseIndex(const QModelIndex &index);
+    void chooseFirst();
+
+private:
+    enum { VISIBLE_ROWS = 16 };
+
+    FontListModel *model;
+    QLineEdit *filterEdit;
+    QListView *listView;
+    QSortFilterProxyModel *filterModel;
+};
+
+#endif
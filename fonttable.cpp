@@ -0,0 +1,95 @@
+#include "fonttable.h"
+
+FontTable::Style::Style(const QFont &f)
+    : font(f), metrics(f)
+{
+    height = metrics.height();
+    for(int i = 0; i < 256; ++i)
+        latin1[i] = metrics.width(QChar(static_cast<ushort>(i)));
+}
+
+FontTable::FontTable()
+{
+    for(int i = 0; i < CHUNK_COUNT; ++i)
+        chunks_[i] = Q_NULLPTR;
+    count_.store(0);
+    wideCount_.store(0);
+    defaultStyle_.store(-1);
+}
+
+FontTable::~FontTable()
+{
+    for(int i = 0; i < CHUNK_COUNT; ++i){
+        if(!chunks_[i])
+            continue;
+        for(int j = 0; j < CHUNK_SIZE; ++j)
+            delete chunks_[i][j];
+        delete[] chunks_[i];
+    }
+}
+
+FontTable& FontTable::instance()
+{
+    static FontTable *table = new FontTable;
+    return *table;
+}
+
+quint16 FontTable::intern(const QFont &font)
+{
+    QMutexLocker locker(&mutex_);
+    QHash<QFont, quint16>::const_iterator it = index_.constFind(font);
+    if(it != index_.constEnd())
+        return it.value();
+
+    int style = count_.load();
+    Q_ASSERT(style < CHUNK_SIZE * CHUNK_COUNT);
+    Style **&chunk = chunks_[style / CHUNK_SIZE];
+    if(!chunk){
+        chunk = new Style*[CHUNK_SIZE];
+        for(int j = 0; j < CHUNK_SIZE; ++j)
+            chunk[j] = Q_NULLPTR;
+    }
+    chunk[style % CHUNK_SIZE] = new Style(font);
+    index_.insert(font, static_cast<quint16>(style));
+    count_.storeRelease(style + 1);
+    return static_cast<quint16>(style);
+}
+
+quint16 FontTable::defaultStyle()
+{
+    int style = defaultStyle_.loadAcquire();
+    if(style < 0){
+        QFont f = QFont(QString("Monospace"), 14);
+        f.setBold(false);
+        f.setItalic(false);
+        style = intern(f);
+        defaultStyle_.storeRelease(style);
+    }
+    return static_cast<quint16>(style);
+}
+
+qint64 FontTable::memoryUsage() const
+{
+    int count = count_.load();
+    int chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    return qint64(count) * (sizeof(Style) + INDEX_ENTRY_BYTES) +
+            qint64(chunks) * CHUNK_SIZE * sizeof(Style*) +
+            qint64(wideCount_.load()) * WIDE_ENTRY_BYTES;
+}
+
+int FontTable::width(quint16 style, QChar value)
+{
+    Style *s = style_at(style);
+    ushort code = value.unicode();
+    if(code < 256)
+        return s->latin1[code];
+
+    QMutexLocker locker(&s->wideMutex);
+    QHash<ushort, int>::const_iterator it = s->wide.constFind(code);
+    if(it != s->wide.constEnd())
+        return it.value();
+    int w = s->metrics.width(value);
+    s->wide.insert(code, w);
+    wideCount_.ref();
+    return w;
+}
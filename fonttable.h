@@ -0,0 +1,51 @@
+#ifndef FONTTABLE_H
+#define FONTTABLE_H
+
+#include <QtGui>
+
+class FontTable
+{
+public:
+    static FontTable& instance();
+
+    quint16 intern(const QFont& font);
+    quint16 defaultStyle();
+
+    inline const QFont& font(quint16 style) const { return style_at(style)->font; }
+    inline int height(quint16 style) const { return style_at(style)->height; }
+    int width(quint16 style, QChar value);
+    inline const int *latin1Widths(quint16 style) const { return style_at(style)->latin1; }
+
+    inline int count() const { return count_.load(); }
+    qint64 memoryUsage() const;
+
+private:
+    FontTable();
+    ~FontTable();
+    Q_DISABLE_COPY(FontTable)
+
+    enum { CHUNK_SIZE = 256, CHUNK_COUNT = 256, WIDE_ENTRY_BYTES = 24, INDEX_ENTRY_BYTES = 64 };
+
+    struct Style
+    {
+        explicit Style(const QFont& f);
+
+        QFont font;
+        QFontMetrics metrics;
+        int height;
+        int latin1[256];
+        QMutex wideMutex;
+        QHash<ushort, int> wide;
+    };
+
+    inline Style *style_at(quint16 style) const { return chunks_[style / CHUNK_SIZE][style % CHUNK_SIZE]; }
+
+    Style **chunks_[CHUNK_COUNT];
+    QAtomicInt count_;
+    QAtomicInt wideCount_;
+    QMutex mutex_;
+    QHash<QFont, quint16> index_;
+    QAtomicInt defaultStyle_;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef GAPBUFFER_H
+#define GAPBUFFER_H
+
+#include <QtCore>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "arena.h"
+
+template <class T>
+class GapBuffer
+{
+public:
+    explicit GapBuffer(Arena *arena = Q_NULLPTR, Arena::Usage usage = Arena::ContentUsage)
+        : data_(Q_NULLPTR), capacity_(0), gapBegin_(0), gapEnd_(0), usage_(usage), arena_(arena) {}
+
+    GapBuffer(const GapBuffer& other)
+        : data_(Q_NULLPTR), capacity_(0), gapBegin_(0), gapEnd_(0), usage_(other.usage_),
+          arena_(other.arena_)
+    {
+        assign(other);
+    }
+
+    GapBuffer& operator=(const GapBuffer& other)
+    {
+        if(this != &other){
+            clear();
+            arena_ = other.arena_;
+            usage_ = other.usage_;
+            assign(other);
+        }
+        return *this;
+    }
+
+    ~GapBuffer() { clear(); }
+
+    inline int size() const { return capacity_ - gapSize(); }
+    inline int length() const { return size(); }
+    inline bool isEmpty() const { return !size(); }
+    inline int gapSize() const { return gapEnd_ - gapBegin_; }
+    inline int capacity() const { return capacity_; }
+
+    inline const T& at(int pos) const { return data_[index(pos)]; }
+    inline T& operator[](int pos) { return data_[index(pos)]; }
+    inline const T& operator[](int pos) const { return data_[index(pos)]; }
+    inline const T& first() const { return at(0); }
+    inline const T& last() const { return at(size() - 1); }
+
+    inline const T *contiguous() const
+    {
+        return gapBegin_ >= size() || !gapSize() ? data_ : Q_NULLPTR;
+    }
+
+    inline Arena *arena() const { return arena_; }
+
+    void setArena(Arena *arena)
+    {
+        if(arena == arena_)
+            return;
+        GapBuffer moved(arena, usage_);
+        moved.assign(*this);
+        swap(moved);
+    }
+
+    void insert(int pos, const T& value)
+    {
+        if(!gapSize())
+            grow(1);
+        moveGap(pos);
+        data_[gapBegin_++] = value;
+    }
+
+    void append(const T *values, int count)
+    {
+        if(gapSize() < count)
+            grow(count);
+        moveGap(size());
+        std::memcpy(data_ + gapBegin_, values, count * sizeof(T));
+        gapBegin_ += count;
+    }
+
+    T erase(int pos)
+    {
+        moveGap(pos);
+        return data_[gapEnd_++];
+    }
+
+    inline void push_back(const T& value) { insert(size(), value); }
+    inline void push_front(const T& value) { insert(0, value); }
+    inline T pop_front() { return erase(0); }
+    inline T pop_back() { return erase(size() - 1); }
+
+    // True when compact() would leave the buffer as it is.
+    inline bool isCompact() const
+    {
+        return gapBegin_ >= size() && gapSize() * int(sizeof(T)) < SLACK_BYTES;
+    }
+
+    void compact()
+    {
+        if(gapSize() * int(sizeof(T)) < SLACK_BYTES){
+            moveGap(size());
+            return;
+        }
+        GapBuffer compacted(arena_, usage_);
+        compacted.assign(*this);
+        swap(compacted);
+    }
+
+    void clear()
+    {
+        release(data_, capacity_);
+        data_ = Q_NULLPTR;
+        capacity_ = gapBegin_ = gapEnd_ = 0;
+    }
+
+    void swap(GapBuffer& other)
+    {
+        qSwap(data_, other.data_);
+        qSwap(capacity_, other.capacity_);
+        qSwap(gapBegin_, other.gapBegin_);
+        qSwap(gapEnd_, other.gapEnd_);
+        qSwap(usage_, other.usage_);
+        qSwap(arena_, other.arena_);
+    }
+
+private:
+    enum { MIN_GAP = 16, SLACK_BYTES = 16 };
+
+    inline int index(int pos) const { return pos < gapBegin_ ? pos : pos + gapSize(); }
+
+    T *allocate(int count, int &capacity)
+    {
+        int bytes = 0;
+        void *p;
+        if(arena_)
+            p = arena_->allocate(count * sizeof(T), bytes, usage_);
+        else{
+            bytes = count * sizeof(T);
+            p = ::malloc(bytes);
+        }
+        capacity = bytes / sizeof(T);
+        return static_cast<T*>(p);
+    }
+
+    void release(T *data, int capacity)
+    {
+        if(!data)
+            return;
+        if(arena_)
+            arena_->release(data, capacity * sizeof(T), usage_);
+        else
+            ::free(data);
+    }
+
+    void assign(const GapBuffer& other)
+    {
+        int count = other.size();
+        if(!count)
+            return;
+        data_ = allocate(count, capacity_);
+        std::memcpy(data_, other.data_, other.gapBegin_ * sizeof(T));
+        std::memcpy(data_ + other.gapBegin_, other.data_ + other.gapEnd_,
+                    (other.capacity_ - other.gapEnd_) * sizeof(T));
+        gapBegin_ = count;
+        gapEnd_ = capacity_;
+    }
+
+    void moveGap(int pos)
+    {
+        if(pos < gapBegin_){
+            int count = gapBegin_ - pos;
+            std::memmove(data_ + gapEnd_ - count, data_ + pos, count * sizeof(T));
+            gapBegin_ -= count;
+            gapEnd_ -= count;
+        }
+        else if(pos > gapBegin_){
+            int count = pos - gapBegin_;
+            std::memmove(data_ + gapBegin_, data_ + gapEnd_, count * sizeof(T));
+            gapBegin_ += count;
+            gapEnd_ += count;
+        }
+    }
+
+    void grow(int need)
+    {
+        int count = size();
+        int newCapacity = 0;
+        T *data = allocate(count + qMax<int>(need, qMax<int>(MIN_GAP, count / 2)), newCapacity);
+        int tail = capacity_ - gapEnd_;
+        if(data_){
+            std::memcpy(data, data_, gapBegin_ * sizeof(T));
+            std::memcpy(data + newCapacity - tail, data_ + gapEnd_, tail * sizeof(T));
+        }
+        release(data_, capacity_);
+        data_ = data;
+        capacity_ = newCapacity;
+        gapEnd_ = newCapacity - tail;
+    }
+
+    T *data_;
+    int capacity_;
+    int gapBegin_;
+    int gapEnd_;
+    Arena::Usage usage_;
+    Arena *arena_;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "highlighter.h"
+
+SyntaxRule::SyntaxRule(const QString &b, const QString &e, QRgb c)
+    : begin(b), end(e), color(c)
+{
+}
+
+SyntaxDefinition::SyntaxDefinition(const QString &name)
+    : name_(name)
+{
+}
+
+void SyntaxDefinition::addSuffixes(const QStringList &suffixes)
+{
+    suffixes_ += suffixes;
+}
+
+void SyntaxDefinition::addRule(const QString &pattern, QRgb color)
+{
+    rules_.append(SyntaxRule(pattern, QString(), color));
+}
+
+void SyntaxDefinition::addKeywords(const QStringList &words, QRgb color)
+{
+    addRule("\\b(?:" + words.join('|') + ")\\b", color);
+}
+
+void SyntaxDefinition::addBlock(const QString &begin, const QString &end, QRgb color)
+{
+    rules_.append(SyntaxRule(begin, end, color));
+}
+
+int SyntaxDefinition::tokenize(const QString &text, int state, HighlightSpans &spans) const
+{
+    int n = text.size();
+    int pos = 0;
+    if(state > 0 && state <= rules_.size()){
+        const SyntaxRule& rule = rules_.at(state - 1);
+        QRegularExpressionMatch match = rule.end.match(text);
+        if(!match.hasMatch()){
+            if(n)
+                spans.append(HighlightSpan(0, n, rule.color));
+            return state;
+        }
+        pos = match.capturedEnd();
+        if(pos)
+            spans.append(HighlightSpan(0, pos, rule.color));
+    }
+
+    QVarLengthArray<int, 16> begins(rules_.size());
+    QVarLengthArray<int, 16> ends(rules_.size());
+    for(int i = 0; i < rules_.size(); ++i)
+        begins[i] = -2;
+
+    while(pos < n){
+        int best = -1;
+        for(int i = 0; i < rules_.size(); ++i){
+            if(begins[i] == -1)
+                continue;
+            if(begins[i] < pos){
+                QRegularExpressionMatch match = rules_.at(i).begin.match(text, pos);
+                if(!match.hasMatch()){
+                    begins[i] = -1;
+                    continue;
+                }
+                begins[i] = match.capturedStart();
+                ends[i] = match.capturedEnd();
+            }
+            if(best < 0 || begins[i] < begins[best])
+                best = i;
+        }
+        if(best < 0)
+            break;
+
+        const SyntaxRule& rule = rules_.at(best);
+        int start = begins[best];
+        int end = ends[best];
+        if(rule.isBlock()){
+            QRegularExpressionMatch match = rule.end.match(text, end);
+            if(!match.hasMatch()){
+                spans.append(HighlightSpan(start, n - start, rule.color));
+                return best + 1;
+            }
+            end = match.capturedEnd();
+        }
+        if(end > start)
+            spans.append(HighlightSpan(start, end - start, rule.color));
+        pos = qMax(end, start + 1);
+    }
+    return 0;
+}
+
+static QList<SyntaxDefinition> builtin_definitions()
+{
+    const QRgb comment = qRgb(0x00, 0x80, 0x00);
+    const QRgb keyword = qRgb(0x00, 0x00, 0x80);
+    const QRgb string = qRgb(0xA3, 0x15, 0x15);
+    const QRgb number = qRgb(0x00, 0x80, 0x80);
+    const QRgb directive = qRgb(0x80, 0x00, 0x80);
+    const QString quoted = "\"(?:[^\"\\\\]|\\\\.)*\"?";
+    const QString numeric = "\\b(?:0[xX][0-9A-Fa-f]+|[0-9]+(?:\\.[0-9]*)?(?:[eE][+-]?[0-9]+)?)[uUlLfF]*\\b";
+
+    QList<SyntaxDefinition> definitions;
+
+    SyntaxDefinition cpp("C++");
+    cpp.addSuffixes(QStringList() << "c" << "cc" << "cpp" << "cxx" << "h" << "hh" << "hpp" << "hxx" << "inl");
+    cpp.addBlock("/\\*", "\\*/", comment);
+    cpp.addRule("//.*", comment);
+    cpp.addRule("^\\s*#\\s*[A-Za-z_]+", directive);
+    cpp.addRule(quoted, string);
+    cpp.addRule("'(?:[^'\\\\]|\\\\.)*'?", string);
+    cpp.addRule(numeric, number);
+    cpp.addKeywords(QStringList()
+                    << "alignas" << "alignof" << "auto" << "bool" << "break" << "case" << "catch"
+                    << "char" << "class" << "const" << "constexpr" << "const_cast" << "continue"
+                    << "decltype" << "default" << "delete" << "do" << "double" << "dynamic_cast"
+                    << "else" << "enum" << "explicit" << "extern" << "false" << "float" << "for"
+                    << "friend" << "goto" << "if" << "inline" << "int" << "long" << "mutable"
+                    << "namespace" << "new" << "noexcept" << "nullptr" << "operator" << "override"
+                    << "private" << "protected" << "public" << "register" << "reinterpret_cast"
+                    << "return" << "short" << "signed" << "sizeof" << "static" << "static_assert"
+                    << "static_cast" << "struct" << "switch" << "template" << "this" << "throw"
+                    << "true" << "try" << "typedef" << "typename" << "union" << "unsigned"
+                    << "using" << "virtual" << "void" << "volatile" << "while"
+                    << "signals" << "slots" << "emit" << "foreach", keyword);
+    definitions.append(cpp);
+
+    SyntaxDefinition config("Config");
+    config.addSuffixes(QStringList() << "ini" << "cfg" << "conf" << "pro" << "pri" << "properties" << "toml");
+    config.addRule("^\\s*;.*|#.*", comment);
+    config.addRule("^\\s*\\[[^\\]]*\\]", keyword);
+    config.addRule("^\\s*[\\w.\\-]+(?=\\s*[+*\\-]?[=:])", directive);
+    config.addRule(quoted, string);
+    config.addRule("\\$\\$?\\{?\\w+\\}?", directive);
+    config.addRule(numeric, number);
+    config.addKeywords(QStringList() << "true" << "false" << "yes" << "no" << "on" << "off", keyword);
+    definitions.append(config);
+
+    return definitions;
+}
+
+const SyntaxDefinition *SyntaxDefinition::forFile(const QString &fileName)
+{
+    static const QList<SyntaxDefinition> definitions = builtin_definitions();
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if(suffix.isEmpty())
+        return Q_NULLPTR;
+    for(int i = 0; i < definitions.size(); ++i)
+        if(definitions.at(i).suffixes().contains(suffix))
+            return &definitions.at(i);
+    return Q_NULLPTR;
+}
+
+static inline qint64 span_bytes(const HighlightSpans& spans)
+{
+    return spans.capacity() * qint64(sizeof(HighlightSpan));
+}
+
+Highlighter::Highlighter(QObject *parent)
+    : QObject(parent), text_(Q_NULLPTR), definition_(Q_NULLPTR), spanBytes_(0), dirty_(0), stale_(0), invalid_(0)
+{
+}
+
+void Highlighter::setText(const Text *text)
+{
+    text_ = text;
+    if(text_)
+        connect(text_, SIGNAL( linesChanged(int, int, int) ), SLOT( on_lines_changed(int, int, int) ),
+                Qt::UniqueConnection);
+    reset();
+}
+
+void Highlighter::setDefinition(const SyntaxDefinition *definition)
+{
+    if(definition == definition_)
+        return;
+    definition_ = definition;
+    reset();
+}
+
+bool Highlighter::highlight(int last, int budget)
+{
+    if(!definition_)
+        return true;
+    int first = -1;
+    int changed = -1;
+    bool done = process(last, IdleDeadline(budget), first, changed);
+    schedule();
+    return done;
+}
+
+void Highlighter::on_lines_changed(int line, int removed, int added)
+{
+    if(!definition_)
+        return;
+    if(line < dirty_)
+        invalidate(dirty_);
+    if(removed != added){
+        for(int i = line; i < line + removed; ++i){
+            if(!lines_.at(i).valid)
+                --invalid_;
+            spanBytes_ -= span_bytes(lines_.at(i).spans);
+        }
+        lines_.remove(line, removed);
+        lines_.insert(line, added, LineState());
+        invalid_ += added;
+        if(!added)
+            invalidate(line);
+
+        if(stale_ >= line + removed)
+            stale_ += added - removed;
+        else if(stale_ > line)
+            stale_ = line + added;
+    }
+    else
+        for(int i = line; i < line + added; ++i)
+            invalidate(i);
+
+    if(line < dirty_)
+        dirty_ = line;
+    schedule();
+}
+
+bool Highlighter::idle_slice(const IdleDeadline &deadline)
+{
+    if(!definition_)
+        return true;
+    int first = -1;
+    int changed = -1;
+    process(lines_.size(), deadline, first, changed);
+    if(first >= 0)
+        emit highlightChanged(first, changed);
+    return isFinished();
+}
+
+void Highlighter::reset()
+{
+    IdleScheduler::instance().cancel(this, 0);
+    lines_.clear();
+    spanBytes_ = 0;
+    dirty_ = stale_ = invalid_ = 0;
+    if(!text_ || !definition_)
+        return;
+    lines_.resize(text_->length());
+    invalid_ = lines_.size();
+    schedule();
+}
+
+void Highlighter::invalidate(int line)
+{
+    if(line < lines_.size() && lines_.at(line).valid){
+        lines_[line].valid = false;
+        ++invalid_;
+    }
+}
+
+bool Highlighter::process(int last, const IdleDeadline &deadline, int &first, int &changed)
+{
+    int state = dirty_ > 0 ? lines_.at(dirty_ - 1).out : 0;
+    int count = 0;
+    while(dirty_ < lines_.size() && dirty_ <= last){
+        LineState& entry = lines_[dirty_];
+        if(entry.valid && entry.in == state){
+            if(!invalid_ && dirty_ < stale_){
+                dirty_ = stale_;
+                state = lines_.at(dirty_ - 1).out;
+                continue;
+            }
+            state = entry.out;
+        }
+        else{
+            if(!entry.valid)
+                --invalid_;
+            spanBytes_ -= span_bytes(entry.spans);
+            entry.spans.clear();
+            entry.in = state;
+            state = definition_->tokenize(text_->at(dirty_).text(), state, entry.spans);
+            spanBytes_ += span_bytes(entry.spans);
+            entry.out = state;
+            entry.valid = true;
+            if(first < 0)
+                first = dirty_;
+            changed = dirty_;
+        }
+        if(++dirty_ > stale_)
+            stale_ = dirty_;
+        if(!(++count % CHECK_INTERVAL) && deadline.expired())
+            break;
+    }
+    return dirty_ > last || isFinished();
+}
+
+void Highlighter::schedule()
+{
+    if(definition_ && !isFinished() && !IdleScheduler::instance().isPending(this, 0))
+        IdleScheduler::instance().post(this, 0, IdleScheduler::NormalPriority,
+                                       [this](const IdleDeadline& deadline) { return idle_slice(deadline); });
+}
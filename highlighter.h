@@ -0,0 +1,104 @@
+#ifndef HIGHLIGHTER_H
+#define HIGHLIGHTER_H
+
+#include <QtCore>
+#include <QtGui>
+
+#include "char.h"
+#include "scheduler.h"
+
+struct SyntaxRule
+{
+    SyntaxRule() : color(0) {}
+    SyntaxRule(const QString& begin, const QString& end, QRgb color);
+
+    inline bool isBlock() const { return !end.pattern().isEmpty(); }
+
+    QRegularExpression begin;
+    QRegularExpression end;
+    QRgb color;
+};
+
+Q_DECLARE_TYPEINFO(SyntaxRule, Q_MOVABLE_TYPE);
+
+class SyntaxDefinition
+{
+public:
+    explicit SyntaxDefinition(const QString& name = QString());
+
+    inline const QString& name() const { return name_; }
+    inline const QStringList& suffixes() const { return suffixes_; }
+
+    void addSuffixes(const QStringList& suffixes);
+    void addRule(const QString& pattern, QRgb color);
+    void addKeywords(const QStringList& words, QRgb color);
+    void addBlock(const QString& begin, const QString& end, QRgb color);
+
+    int tokenize(const QString& text, int state, HighlightSpans& spans) const;
+
+    static const SyntaxDefinition *forFile(const QString& fileName);
+
+private:
+    QString name_;
+    QStringList suffixes_;
+    QVector<SyntaxRule> rules_;
+};
+
+class Highlighter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { PAINT_BUDGET = 4 };
+
+    explicit Highlighter(QObject *parent = Q_NULLPTR);
+
+    void setText(const Text *text);
+    void setDefinition(const SyntaxDefinition *definition);
+    inline const SyntaxDefinition *definition() const { return definition_; }
+
+    inline bool isFinished() const { return dirty_ >= lines_.size(); }
+    inline qint64 memoryUsage() const { return lines_.capacity() * qint64(sizeof(LineState)) + spanBytes_; }
+    bool highlight(int last, int budget);
+
+    inline const HighlightSpans& spans(int line) const
+    {
+        return line < lines_.size() ? lines_.at(line).spans : empty_;
+    }
+
+signals:
+    void highlightChanged(int first, int last);
+
+private slots:
+    void on_lines_changed(int line, int removed, int added);
+
+private:
+    enum { CHECK_INTERVAL = 16 };
+
+    struct LineState
+    {
+        LineState() : in(0), out(0), valid(false) {}
+
+        HighlightSpans spans;
+        int in;
+        int out;
+        bool valid;
+    };
+
+    void reset();
+    void invalidate(int line);
+    bool idle_slice(const IdleDeadline& deadline);
+    bool process(int last, const IdleDeadline& deadline, int &first, int &changed);
+    void schedule();
+
+    const Text *text_;
+    const SyntaxDefinition *definition_;
+    QVector<LineState> lines_;
+    HighlightSpans empty_;
+    qint64 spanBytes_;
+    int dirty_;
+    int stale_;
+    int invalid_;
+};
+
+#endif
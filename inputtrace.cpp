@@ -0,0 +1,241 @@
+#include "inputtrace.h"
+
+bool InputTrace::isRecorded(QEvent::Type type)
+{
+    switch(type){
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+        return true;
+    default:
+        return false;
+    }
+}
+
+InputEvent InputTrace::capture(const QEvent *event, qint64 time)
+{
+    InputEvent result;
+    result.time = time;
+    result.type = event->type();
+    switch(event->type()){
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:{
+        const QKeyEvent *key = static_cast<const QKeyEvent*>(event);
+        result.key = key->key();
+        result.modifiers = key->modifiers();
+        result.text = key->text();
+        result.autoRepeat = key->isAutoRepeat();
+        break;
+    }
+    case QEvent::Wheel:{
+        const QWheelEvent *wheel = static_cast<const QWheelEvent*>(event);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        result.pos = wheel->position().toPoint();
+#else
+        result.pos = wheel->pos();
+#endif
+        result.buttons = wheel->buttons();
+        result.modifiers = wheel->modifiers();
+        result.angle = wheel->angleDelta();
+        break;
+    }
+    default:{
+        const QMouseEvent *mouse = static_cast<const QMouseEvent*>(event);
+        result.pos = mouse->pos();
+        result.button = mouse->button();
+        result.buttons = mouse->buttons();
+        result.modifiers = mouse->modifiers();
+        break;
+    }
+    }
+    return result;
+}
+
+QEvent *InputTrace::create(const InputEvent &event)
+{
+    QEvent::Type type = QEvent::Type(event.type);
+    Qt::KeyboardModifiers modifiers(event.modifiers);
+    switch(type){
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+        return new QKeyEvent(type, event.key, modifiers, event.text, event.autoRepeat);
+    case QEvent::Wheel:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        return new QWheelEvent(QPointF(event.pos), QPointF(event.pos), QPoint(), event.angle,
+                               Qt::MouseButtons(event.buttons), modifiers, Qt::NoScrollPhase, false);
+#else
+        return new QWheelEvent(QPointF(event.pos), QPointF(event.pos), QPoint(), event.angle,
+                               event.angle.y() ? event.angle.y() : event.angle.x(),
+                               event.angle.y() ? Qt::Vertical : Qt::Horizontal,
+                               Qt::MouseButtons(event.buttons), modifiers);
+#endif
+    default:
+        return new QMouseEvent(type, QPointF(event.pos), Qt::MouseButton(event.button),
+                               Qt::MouseButtons(event.buttons), modifiers);
+    }
+}
+
+bool InputTrace::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint32(MAGIC) << quint32(VERSION) << viewportSize_ << qint32(events_.size());
+    foreach (const InputEvent& event, events_) {
+        out << event.time << qint32(event.type) << qint32(event.key) << qint32(event.modifiers)
+            << event.text << event.autoRepeat << event.pos << qint32(event.button)
+            << qint32(event.buttons) << event.angle;
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+bool InputTrace::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic, version;
+    qint32 count;
+    in >> magic >> version;
+    if(magic != quint32(MAGIC) || version != quint32(VERSION))
+        return false;
+    in >> viewportSize_ >> count;
+
+    events_.clear();
+    events_.reserve(qMax(count, 0));
+    for(qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i){
+        InputEvent event;
+        qint32 type, key, modifiers, button, buttons;
+        in >> event.time >> type >> key >> modifiers >> event.text >> event.autoRepeat
+           >> event.pos >> button >> buttons >> event.angle;
+        event.type = type;
+        event.key = key;
+        event.modifiers = modifiers;
+        event.button = button;
+        event.buttons = buttons;
+        events_.append(event);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+InputRecorder::InputRecorder(QObject *parent)
+    : QObject(parent), begin_(0)
+{
+}
+
+void InputRecorder::start(QAbstractScrollArea *target)
+{
+    if(isRecording())
+        stop();
+    target_ = target;
+    trace_ = InputTrace();
+    trace_.setViewportSize(target->viewport()->size());
+    begin_ = LatencyMonitor::now();
+    target->installEventFilter(this);
+    target->viewport()->installEventFilter(this);
+}
+
+InputTrace InputRecorder::stop()
+{
+    if(target_){
+        target_->removeEventFilter(this);
+        target_->viewport()->removeEventFilter(this);
+    }
+    target_ = Q_NULLPTR;
+    InputTrace result = trace_;
+    trace_ = InputTrace();
+    return result;
+}
+
+bool InputRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    if(target_ && InputTrace::isRecorded(event->type())){
+        bool key = event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease;
+        if(key ? watched == target_ : watched == target_->viewport())
+            trace_.append(InputTrace::capture(event, LatencyMonitor::now() - begin_));
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+InputReplayer::InputReplayer(QAbstractScrollArea *target)
+    : target_(target), speed_(1.0), total_(0)
+{
+}
+
+int InputReplayer::slot_of(int type)
+{
+    switch(type){
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+        return KEY_SLOT;
+    case QEvent::Wheel:
+        return WHEEL_SLOT;
+    default:
+        return MOUSE_SLOT;
+    }
+}
+
+static void run_event_loop(qint64 msecs)
+{
+    QEventLoop loop;
+    QTimer::singleShot(int(qMax<qint64>(msecs, 0)), &loop, SLOT( quit() ));
+    loop.exec();
+}
+
+void InputReplayer::replay(const InputTrace &trace)
+{
+    for(int i = 0; i < SLOT_COUNT; ++i)
+        latency_[i].clear();
+    LatencyMonitor::instance().reset();
+
+    if(trace.viewportSize().isValid())
+        target_->resize(target_->size() - target_->viewport()->size() + trace.viewportSize());
+    QCoreApplication::processEvents();
+
+    QElapsedTimer clock;
+    clock.start();
+    foreach (const InputEvent& recorded, trace.events()) {
+        if(speed_ > 0){
+            qint64 due = qint64(recorded.time / speed_) / 1000000;
+            if(due > clock.elapsed())
+                run_event_loop(due - clock.elapsed());
+        }
+        QScopedPointer<QEvent> event(InputTrace::create(recorded));
+        int slot = slot_of(recorded.type);
+        QObject *receiver = slot == KEY_SLOT ? static_cast<QObject*>(target_) : target_->viewport();
+
+        qint64 begin = LatencyMonitor::now();
+        QCoreApplication::sendEvent(receiver, event.data());
+        latency_[slot].add((LatencyMonitor::now() - begin) / 1000);
+        QCoreApplication::processEvents();
+    }
+    run_event_loop(SETTLE_INTERVAL);
+    total_ = clock.nsecsElapsed();
+}
+
+QString InputReplayer::report() const
+{
+    static const char *names[SLOT_COUNT] = { "key", "mouse", "wheel" };
+    QString result = QString("total %1 ms\n").arg(total_ / 1000000.0, 0, 'f', 1);
+    result += "event,count,p50_us,p90_us,p99_us,max_us\n";
+    for(int i = 0; i < SLOT_COUNT; ++i){
+        const LatencyHistogram& h = latency_[i];
+        result += QString("%1,%2,%3,%4,%5,%6\n").arg(names[i]).arg(h.count())
+                .arg(h.percentile(0.5)).arg(h.percentile(0.9)).arg(h.percentile(0.99)).arg(h.max());
+    }
+    for(int i = 0; i < LatencyMonitor::PHASE_COUNT; ++i){
+        LatencyMonitor::Phase phase = LatencyMonitor::Phase(i);
+        const LatencyHistogram& h = LatencyMonitor::instance().histogram(phase);
+        result += QString("%1,%2,%3,%4,%5,%6\n").arg(LatencyMonitor::phaseName(phase)).arg(h.count())
+                .arg(h.percentile(0.5)).arg(h.percentile(0.9)).arg(h.percentile(0.99)).arg(h.max());
+    }
+    return result;
+}
@@ -0,0 +1,99 @@
+#ifndef INPUTTRACE_H
+#define INPUTTRACE_H
+
+#include <QtWidgets>
+
+#include "latency.h"
+
+struct InputEvent
+{
+    InputEvent() : time(0), type(QEvent::None), key(0), modifiers(0), autoRepeat(false),
+        button(0), buttons(0) {}
+
+    qint64 time;
+    int type;
+    int key;
+    int modifiers;
+    QString text;
+    bool autoRepeat;
+    QPoint pos;
+    int button;
+    int buttons;
+    QPoint angle;
+};
+
+Q_DECLARE_TYPEINFO(InputEvent, Q_MOVABLE_TYPE);
+
+class InputTrace
+{
+public:
+    InputTrace() {}
+
+    inline const QVector<InputEvent>& events() const { return events_; }
+    inline int size() const { return events_.size(); }
+    inline bool isEmpty() const { return events_.isEmpty(); }
+    inline qint64 duration() const { return events_.isEmpty() ? 0 : events_.last().time; }
+    void append(const InputEvent& event) { events_.append(event); }
+
+    inline const QSize& viewportSize() const { return viewportSize_; }
+    inline void setViewportSize(const QSize& size) { viewportSize_ = size; }
+
+    bool save(const QString& fileName) const;
+    bool load(const QString& fileName);
+
+    static bool isRecorded(QEvent::Type type);
+    static InputEvent capture(const QEvent *event, qint64 time);
+    static QEvent *create(const InputEvent& event);
+
+private:
+    enum { MAGIC = 0x54455452, VERSION = 1 };
+
+    QVector<InputEvent> events_;
+    QSize viewportSize_;
+};
+
+class InputRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InputRecorder(QObject *parent = Q_NULLPTR);
+
+    inline bool isRecording() const { return target_ != Q_NULLPTR; }
+    void start(QAbstractScrollArea *target);
+    InputTrace stop();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event);
+
+private:
+    QPointer<QAbstractScrollArea> target_;
+    InputTrace trace_;
+    qint64 begin_;
+};
+
+class InputReplayer
+{
+public:
+    explicit InputReplayer(QAbstractScrollArea *target);
+
+    inline void setSpeed(double speed) { speed_ = speed; }
+    void replay(const InputTrace& trace);
+
+    inline qint64 total() const { return total_; }
+    inline const LatencyHistogram& latency(int type) const { return latency_[slot_of(type)]; }
+    QString report() const;
+
+private:
+    enum { KEY_SLOT, MOUSE_SLOT, WHEEL_SLOT, SLOT_COUNT };
+    enum { SETTLE_INTERVAL = 100 };
+
+    static int slot_of(int type);
+
+    QAbstractScrollArea *target_;
+    double speed_;
+    qint64 total_;
+    LatencyHistogram latency_[SLOT_COUNT];
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "instance.h"
+
+SingleInstance::SingleInstance(const QString& key, QObject *parent)
+    : QObject(parent)
+{
+    QString user = QString::fromLocal8Bit(qgetenv("USER"));
+    if(user.isEmpty())
+        user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+    name_ = key + '-' + user;
+    server_ = Q_NULLPTR;
+}
+
+// Hands the files to an editor that is already listening; false when there
+// is none and this process should become the running instance itself.
+bool SingleInstance::forward(const QStringList& files)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name_);
+    if(!socket.waitForConnected(CONNECT_TIMEOUT))
+        return false;
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << files;
+    socket.write(message);
+    if(!socket.waitForBytesWritten(WRITE_TIMEOUT))
+        return false;
+    socket.disconnectFromServer();
+    if(socket.state() != QLocalSocket::UnconnectedState)
+        socket.waitForDisconnected(WRITE_TIMEOUT);
+    return true;
+}
+
+bool SingleInstance::listen()
+{
+    server_ = new QLocalServer(this);
+    server_->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server_, SIGNAL( newConnection() ), SLOT( on_new_connection() ) );
+    if(server_->listen(name_))
+        return true;
+    if(server_->serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+    // The name is taken either by an editor that started at the same time or
+    // by one that crashed. Only a socket nobody answers on may be removed.
+    QLocalSocket probe;
+    probe.connectToServer(name_);
+    if(probe.waitForConnected(CONNECT_TIMEOUT))
+        return false;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    QLocalSocket::LocalSocketError error = probe.socketError();
+#else
+    QLocalSocket::LocalSocketError error = probe.error();
+#endif
+    if(error != QLocalSocket::ServerNotFoundError && error != QLocalSocket::ConnectionRefusedError)
+        return false;
+    QLocalServer::removeServer(name_);
+    return server_->listen(name_);
+}
+
+void SingleInstance::on_new_connection()
+{
+    while(QLocalSocket *socket = server_->nextPendingConnection()){
+        if(socket->state() == QLocalSocket::UnconnectedState)
+            read_files(socket);
+        else
+            connect(socket, SIGNAL( disconnected() ), SLOT( on_disconnected() ) );
+    }
+}
+
+void SingleInstance::on_disconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if(socket)
+        read_files(socket);
+}
+
+// The client writes one file list and disconnects, so the whole message is
+// buffered by the time the socket closes.
+void SingleInstance::read_files(QLocalSocket *socket)
+{
+    QByteArray message = socket->readAll();
+    socket->deleteLater();
+    QDataStream in(message);
+    in.setVersion(QDataStream::Qt_5_6);
+    QStringList files;
+    in >> files;
+    if(in.status() == QDataStream::Ok)
+        emit filesReceived(files);
+}
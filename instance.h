@@ -0,0 +1,33 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <QtNetwork>
+
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(const QString& key, QObject *parent = Q_NULLPTR);
+
+    bool forward(const QStringList& files);
+    bool listen();
+    inline QString errorString() const { return server_ ? server_->errorString() : QString(); }
+
+signals:
+    void filesReceived(const QStringList& files);
+
+private slots:
+    void on_new_connection();
+    void on_disconnected();
+
+private:
+    enum { CONNECT_TIMEOUT = 500, WRITE_TIMEOUT = 3000 };
+
+    void read_files(QLocalSocket *socket);
+
+    QString name_;
+    QLocalServer *server_;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "jobs.h"
+
+struct JobState
+{
+    JobState() : jobClass(JobPool::Background), hasReceiver(false), started(false), finished(false) {}
+
+    JobPool::JobClass jobClass;
+    JobPool::Work work;
+    QPointer<QObject> receiver;
+    bool hasReceiver;
+    JobPool::Completion completion;
+    CancelToken token;
+    bool started;
+    bool finished;
+};
+
+class JobWorker : public QThread
+{
+public:
+    JobWorker(JobPool *pool, int index) : pool_(pool), index_(index) {}
+
+protected:
+    void run() { pool_->work_loop(index_); }
+
+private:
+    JobPool *pool_;
+    int index_;
+};
+
+class JobEvent : public QEvent
+{
+public:
+    explicit JobEvent(const QSharedPointer<JobState>& state) : QEvent(type()), job(state) {}
+
+    static QEvent::Type type()
+    {
+        static const QEvent::Type jobType = QEvent::Type(QEvent::registerEventType());
+        return jobType;
+    }
+
+    QSharedPointer<JobState> job;
+};
+
+bool JobHandle::isFinished() const
+{
+    if(!state_)
+        return true;
+    QMutexLocker locker(&JobPool::instance().mutex_);
+    return state_->finished;
+}
+
+void JobHandle::cancel() const
+{
+    if(!state_)
+        return;
+    state_->token.cancel();
+    JobPool& pool = JobPool::instance();
+    QMutexLocker locker(&pool.mutex_);
+    if(!state_->started && pool.unqueue(state_)){
+        state_->started = true;
+        pool.finish_job(state_);
+    }
+}
+
+void JobHandle::wait() const
+{
+    if(state_)
+        JobPool::instance().wait_job(state_);
+}
+
+CancelToken JobHandle::token() const
+{
+    return state_ ? state_->token : CancelToken();
+}
+
+JobPool::JobPool(QObject *parent)
+    : QObject(parent), next_(0), stopping_(false)
+{
+    int count = qMax(2, QThread::idealThreadCount());
+    for(int c = 0; c < CLASS_COUNT; ++c){
+        queues_[c].resize(count);
+        running_[c] = 0;
+        caps_[c] = count;
+    }
+    caps_[Background] = qMax(1, count / 2);
+
+    for(int i = 0; i < count; ++i){
+        JobWorker *worker = new JobWorker(this, i);
+        worker->setObjectName(QString("job worker %1").arg(i));
+        workers_.append(worker);
+    }
+    foreach (JobWorker *worker, workers_)
+        worker->start();
+}
+
+JobPool::~JobPool()
+{
+    mutex_.lock();
+    stopping_ = true;
+    wake_.wakeAll();
+    mutex_.unlock();
+    foreach (JobWorker *worker, workers_) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+JobPool& JobPool::instance()
+{
+    static JobPool *pool = new JobPool(qApp);
+    return *pool;
+}
+
+JobHandle JobPool::submit(JobClass jobClass, const Work &work, QObject *receiver, const Completion &completion)
+{
+    Job job(new JobState);
+    job->jobClass = jobClass;
+    job->work = work;
+    job->receiver = receiver;
+    job->hasReceiver = receiver != Q_NULLPTR;
+    job->completion = completion;
+
+    QMutexLocker locker(&mutex_);
+    int index = -1;
+    for(int i = 0; i < workers_.size() && index < 0; ++i)
+        if(workers_.at(i) == QThread::currentThread())
+            index = i;
+    if(index < 0)
+        index = next_++ % workers_.size();
+    queues_[jobClass][index].append(job);
+    wake_.wakeAll();
+    return JobHandle(job);
+}
+
+void JobPool::parallelFor(JobClass jobClass, int count, int grain, const Range &range)
+{
+    if(count <= 0)
+        return;
+    grain = qMax(1, grain);
+    if(count <= grain){
+        range(0, count);
+        return;
+    }
+
+    QVector<JobHandle> jobs;
+    for(int from = grain; from < count; from += grain){
+        int to = qMin(count, from + grain);
+        jobs.append(submit(jobClass, [range, from, to](const CancelToken&) { range(from, to); }));
+    }
+    range(0, grain);
+    for(int i = 0; i < jobs.size(); ++i)
+        jobs.at(i).wait();
+}
+
+int JobPool::cap(JobClass jobClass) const
+{
+    QMutexLocker locker(&mutex_);
+    return caps_[jobClass];
+}
+
+void JobPool::setCap(JobClass jobClass, int cap)
+{
+    QMutexLocker locker(&mutex_);
+    caps_[jobClass] = qMax(1, cap);
+    wake_.wakeAll();
+}
+
+int JobPool::pendingCount() const
+{
+    QMutexLocker locker(&mutex_);
+    int count = 0;
+    for(int c = 0; c < CLASS_COUNT; ++c)
+        for(int i = 0; i < queues_[c].size(); ++i)
+            count += queues_[c].at(i).size();
+    return count;
+}
+
+void JobPool::customEvent(QEvent *event)
+{
+    if(event->type() != JobEvent::type())
+        return;
+    Job job = static_cast<JobEvent*>(event)->job;
+    if(job->token.isCancelled() || (job->hasReceiver && !job->receiver))
+        return;
+    job->completion();
+}
+
+void JobPool::work_loop(int index)
+{
+    QMutexLocker locker(&mutex_);
+    forever {
+        Job job = take_job(index);
+        if(!job){
+            if(stopping_)
+                return;
+            wake_.wait(&mutex_);
+            continue;
+        }
+        job->started = true;
+        ++running_[job->jobClass];
+        locker.unlock();
+        run_job(job);
+        locker.relock();
+        --running_[job->jobClass];
+        finish_job(job);
+    }
+}
+
+JobPool::Job JobPool::take_job(int index)
+{
+    int count = workers_.size();
+    for(int c = 0; c < CLASS_COUNT; ++c){
+        if(running_[c] >= caps_[c])
+            continue;
+        QList<Job>& own = queues_[c][index];
+        if(!own.isEmpty())
+            return own.takeFirst();
+        for(int k = 1; k < count; ++k){
+            QList<Job>& other = queues_[c][(index + k) % count];
+            if(!other.isEmpty())
+                return other.takeLast();
+        }
+    }
+    return Job();
+}
+
+bool JobPool::unqueue(const Job &job)
+{
+    QVector<QList<Job> >& queues = queues_[job->jobClass];
+    for(int i = 0; i < queues.size(); ++i)
+        if(queues[i].removeOne(job))
+            return true;
+    return false;
+}
+
+void JobPool::run_job(const Job &job)
+{
+    if(!job->token.isCancelled()){
+        try{
+            job->work(job->token);
+        }
+        catch(...)
+        {
+            job->token.cancel();
+        }
+    }
+    if(job->completion)
+        QCoreApplication::postEvent(this, new JobEvent(job));
+}
+
+void JobPool::finish_job(const Job &job)
+{
+    job->finished = true;
+    job->work = Work();
+    finished_.wakeAll();
+    wake_.wakeAll();
+}
+
+void JobPool::wait_job(const Job &job)
+{
+    QMutexLocker locker(&mutex_);
+    if(!job->started && unqueue(job)){
+        job->started = true;
+        locker.unlock();
+        run_job(job);
+        locker.relock();
+        finish_job(job);
+        return;
+    }
+    while(!job->finished)
+        finished_.wait(&mutex_);
+}
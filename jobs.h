@@ -0,0 +1,96 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <QtCore>
+
+#include <functional>
+
+class CancelToken
+{
+public:
+    CancelToken() : state_(new QAtomicInt(0)) {}
+
+    inline void cancel() const { state_->store(1); }
+    inline bool isCancelled() const { return state_->load() != 0; }
+
+private:
+    QSharedPointer<QAtomicInt> state_;
+};
+
+struct JobState;
+class JobWorker;
+
+class JobHandle
+{
+public:
+    JobHandle() {}
+
+    inline bool isNull() const { return state_.isNull(); }
+    bool isFinished() const;
+    void cancel() const;
+    void wait() const;
+    CancelToken token() const;
+
+private:
+    friend class JobPool;
+
+    explicit JobHandle(const QSharedPointer<JobState>& state) : state_(state) {}
+
+    QSharedPointer<JobState> state_;
+};
+
+class JobPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum JobClass { Interactive, Visible, Background, CLASS_COUNT };
+
+    typedef std::function<void (const CancelToken&)> Work;
+    typedef std::function<void ()> Completion;
+    typedef std::function<void (int, int)> Range;
+
+    static JobPool& instance();
+    ~JobPool();
+
+    JobHandle submit(JobClass jobClass, const Work& work,
+                     QObject *receiver = Q_NULLPTR, const Completion& completion = Completion());
+    void parallelFor(JobClass jobClass, int count, int grain, const Range& range);
+
+    inline int workerCount() const { return workers_.size(); }
+    int cap(JobClass jobClass) const;
+    void setCap(JobClass jobClass, int cap);
+    int pendingCount() const;
+
+protected:
+    void customEvent(QEvent *event);
+
+private:
+    friend class JobHandle;
+    friend class JobWorker;
+
+    typedef QSharedPointer<JobState> Job;
+
+    explicit JobPool(QObject *parent = Q_NULLPTR);
+
+    void work_loop(int index);
+    Job take_job(int index);
+    bool unqueue(const Job& job);
+    void run_job(const Job& job);
+    void finish_job(const Job& job);
+    void wait_job(const Job& job);
+
+    mutable QMutex mutex_;
+    QWaitCondition wake_;
+    QWaitCondition finished_;
+    QVector<JobWorker*> workers_;
+    QVector<QList<Job> > queues_[CLASS_COUNT];
+    int running_[CLASS_COUNT];
+    int caps_[CLASS_COUNT];
+    int next_;
+    bool stopping_;
+
+    Q_DISABLE_COPY(JobPool)
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "latency.h"
+
+void LatencyHistogram::add(qint64 usecs)
+{
+    usecs = qMax<qint64>(0, usecs);
+    ++buckets_[bucket_of(usecs)];
+    ++count_;
+    max_ = qMax(max_, usecs);
+}
+
+void LatencyHistogram::clear()
+{
+    for(int i = 0; i < BUCKET_COUNT; ++i)
+        buckets_[i] = 0;
+    count_ = 0;
+    max_ = 0;
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    if(!count_)
+        return 0;
+    qint64 rank = qMax<qint64>(1, qint64(qCeil(p * count_)));
+    qint64 seen = 0;
+    for(int i = 0; i < BUCKET_COUNT; ++i){
+        seen += buckets_[i];
+        if(seen >= rank)
+            return qMin(max_, i + 1 < BUCKET_COUNT ? bucketLow(i + 1) - 1 : max_);
+    }
+    return max_;
+}
+
+qint64 LatencyHistogram::bucketLow(int bucket)
+{
+    if(bucket < SUB_COUNT)
+        return bucket;
+    int shift = bucket / SUB_COUNT - 1;
+    return qint64(SUB_COUNT + bucket % SUB_COUNT) << shift;
+}
+
+int LatencyHistogram::bucket_of(qint64 usecs)
+{
+    if(usecs < SUB_COUNT)
+        return int(usecs);
+    int top = SUB_BITS;
+    while(usecs >> (top + 1))
+        ++top;
+    int bucket = (top - SUB_BITS + 1) * SUB_COUNT + int((usecs >> (top - SUB_BITS)) & (SUB_COUNT - 1));
+    return qMin(bucket, int(BUCKET_COUNT) - 1);
+}
+
+LatencyMonitor::LatencyMonitor()
+    : pendingInput_(-1)
+{
+}
+
+LatencyMonitor& LatencyMonitor::instance()
+{
+    static LatencyMonitor *monitor = new LatencyMonitor;
+    return *monitor;
+}
+
+static QElapsedTimer started_clock()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+qint64 LatencyMonitor::now()
+{
+    static const QElapsedTimer clock = started_clock();
+    return clock.nsecsElapsed();
+}
+
+const char *LatencyMonitor::phaseName(Phase phase)
+{
+    static const char *names[PHASE_COUNT] = { "input", "edit", "metrics", "layout", "paint" };
+    return names[phase];
+}
+
+void LatencyMonitor::inputHandled(qint64 stamp)
+{
+    if(pendingInput_ < 0 || stamp < pendingInput_)
+        pendingInput_ = stamp;
+}
+
+void LatencyMonitor::framePainted(qint64 begin)
+{
+    qint64 end = now();
+    record(Paint, end - begin);
+    if(pendingInput_ >= 0 && end - pendingInput_ < MAX_INPUT_AGE)
+        record(InputLatency, end - pendingInput_);
+    pendingInput_ = -1;
+}
+
+void LatencyMonitor::record(Phase phase, qint64 nsecs)
+{
+    histograms_[phase].add(nsecs / 1000);
+}
+
+void LatencyMonitor::reset()
+{
+    for(int i = 0; i < PHASE_COUNT; ++i)
+        histograms_[i].clear();
+    pendingInput_ = -1;
+}
+
+QString LatencyMonitor::summary() const
+{
+    const LatencyHistogram& input = histograms_[InputLatency];
+    const LatencyHistogram& frame = histograms_[Paint];
+    return QString("input p50 %1 ms  p99 %2 ms\nframe p50 %3 ms  p99 %4 ms\n%5 inputs  %6 frames")
+            .arg(input.percentile(0.5) / 1000.0, 0, 'f', 1)
+            .arg(input.percentile(0.99) / 1000.0, 0, 'f', 1)
+            .arg(frame.percentile(0.5) / 1000.0, 0, 'f', 1)
+            .arg(frame.percentile(0.99) / 1000.0, 0, 'f', 1)
+            .arg(input.count())
+            .arg(frame.count());
+}
+
+bool LatencyMonitor::dump(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+    out << "phase,count,p50_us,p90_us,p99_us,max_us\n";
+    for(int i = 0; i < PHASE_COUNT; ++i){
+        const LatencyHistogram& h = histograms_[i];
+        out << phaseName(Phase(i)) << ',' << h.count() << ',' << h.percentile(0.5) << ','
+            << h.percentile(0.9) << ',' << h.percentile(0.99) << ',' << h.max() << '\n';
+    }
+    out << "\nphase,bucket_low_us,count\n";
+    for(int i = 0; i < PHASE_COUNT; ++i){
+        const LatencyHistogram& h = histograms_[i];
+        for(int b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b)
+            if(h.bucketCount(b))
+                out << phaseName(Phase(i)) << ',' << LatencyHistogram::bucketLow(b) << ','
+                    << h.bucketCount(b) << '\n';
+    }
+    return true;
+}
+
+LatencyHud::LatencyHud(QWidget *parent)
+    : QLabel(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAutoFillBackground(true);
+    setMargin(4);
+    setFont(QFont("Monospace", 8));
+    QPalette pal = palette();
+    pal.setColor(QPalette::Window, QColor(0, 0, 0, 160));
+    pal.setColor(QPalette::WindowText, Qt::white);
+    setPalette(pal);
+
+    timer_ = new QTimer(this);
+    timer_->setInterval(REFRESH_INTERVAL);
+    connect(timer_, SIGNAL( timeout() ), SLOT( on_refresh() ) );
+}
+
+void LatencyHud::showEvent(QShowEvent *event)
+{
+    on_refresh();
+    timer_->start();
+    QLabel::showEvent(event);
+}
+
+void LatencyHud::hideEvent(QHideEvent *event)
+{
+    timer_->stop();
+    QLabel::hideEvent(event);
+}
+
+void LatencyHud::on_refresh()
+{
+    setText(LatencyMonitor::instance().summary());
+    adjustSize();
+}
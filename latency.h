@@ -0,0 +1,91 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <QtWidgets>
+
+class LatencyHistogram
+{
+public:
+    enum { SUB_BITS = 3, SUB_COUNT = 1 << SUB_BITS, BUCKET_COUNT = 256 };
+
+    LatencyHistogram() { clear(); }
+
+    void add(qint64 usecs);
+    void clear();
+
+    inline qint64 count() const { return count_; }
+    inline qint64 max() const { return max_; }
+    qint64 percentile(double p) const;
+
+    inline qint64 bucketCount(int bucket) const { return buckets_[bucket]; }
+    static qint64 bucketLow(int bucket);
+
+private:
+    static int bucket_of(qint64 usecs);
+
+    qint64 buckets_[BUCKET_COUNT];
+    qint64 count_;
+    qint64 max_;
+};
+
+class LatencyMonitor
+{
+public:
+    enum Phase { InputLatency, ModelEdit, Metrics, Layout, Paint, PHASE_COUNT };
+
+    static LatencyMonitor& instance();
+    static qint64 now();
+    static const char *phaseName(Phase phase);
+
+    void inputHandled(qint64 stamp);
+    void framePainted(qint64 begin);
+    void record(Phase phase, qint64 nsecs);
+    void reset();
+
+    inline const LatencyHistogram& histogram(Phase phase) const { return histograms_[phase]; }
+    QString summary() const;
+    bool dump(const QString& fileName) const;
+
+private:
+    enum { MAX_INPUT_AGE = 1000 * 1000 * 1000 };
+
+    LatencyMonitor();
+
+    LatencyHistogram histograms_[PHASE_COUNT];
+    qint64 pendingInput_;
+
+    Q_DISABLE_COPY(LatencyMonitor)
+};
+
+class LatencyScope
+{
+public:
+    explicit LatencyScope(LatencyMonitor::Phase phase) : phase_(phase), begin_(LatencyMonitor::now()) {}
+    ~LatencyScope() { LatencyMonitor::instance().record(phase_, LatencyMonitor::now() - begin_); }
+
+private:
+    LatencyMonitor::Phase phase_;
+    qint64 begin_;
+};
+
+class LatencyHud : public QLabel
+{
+    Q_OBJECT
+
+public:
+    explicit LatencyHud(QWidget *parent = Q_NULLPTR);
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+
+private slots:
+    void on_refresh();
+
+private:
+    enum { REFRESH_INTERVAL = 500 };
+
+    QTimer *timer_;
+};
+
+#endif
@@ -1,9 +1,92 @@
 #include "widget.h"
+#include "trace.h"
+#include "allocprofile.h"
+#include "startup.h"
+#include "instance.h"
+
+static Widget *open_window(const QString& file)
+{
+    Widget *window = new Widget;
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    if(!file.isEmpty())
+        window->loadFile(file);
+    window->raise();
+    window->activateWindow();
+    return window;
+}
 
 int main(int argc, char *argv[])
 {
+    StartupProfiler& startup = StartupProfiler::instance();
+    startup.mark(StartupProfiler::MainEntered);
     QApplication app(argc, argv);
+    startup.mark(StartupProfiler::ApplicationCreated);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Rich text editor.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Files to open, each in its own window.", "[files...]");
+    QCommandLineOption profileOption("startup-profile", "Print startup milestones once the editor is idle.");
+    QCommandLineOption quitOption("quit-after-startup", "Exit once startup has finished.");
+    QCommandLineOption singleOption("single-instance", "Open the files in an already running editor if there is one.");
+    parser.addOption(profileOption);
+    parser.addOption(quitOption);
+    parser.addOption(singleOption);
+    parser.process(app);
+
+    QStringList files;
+    foreach (const QString& file, parser.positionalArguments())
+        files.append(QFileInfo(file).absoluteFilePath());
+
+    // A launch that hands its files to a running editor leaves before any
+    // window or background machinery is set up.
+    QScopedPointer<SingleInstance> instance;
+    if(parser.isSet(singleOption)){
+        instance.reset(new SingleInstance("TextEditor"));
+        if(instance->forward(files))
+            return 0;
+        if(!instance->listen()){
+            // Another editor may have claimed the name after forward() gave up.
+            if(instance->forward(files))
+                return 0;
+            qWarning("Cannot listen for other instances: %s", qPrintable(instance->errorString()));
+        }
+        QObject::connect(instance.data(), &SingleInstance::filesReceived, [](const QStringList& received) {
+            if(received.isEmpty())
+                open_window(QString());
+            foreach (const QString& file, received)
+                open_window(file);
+        });
+    }
+
     Widget w;
+    startup.mark(StartupProfiler::WindowCreated);
     w.show();
-    return app.exec();
+    startup.mark(StartupProfiler::WindowShown);
+    if(!files.isEmpty()){
+        startup.setFileExpected(true);
+        w.loadFile(files.takeFirst());
+    }
+    foreach (const QString& file, files)
+        open_window(file);
+
+    if(parser.isSet(profileOption))
+        QObject::connect(&startup, &StartupProfiler::finished, [&startup]() {
+            QTextStream out(stdout);
+            out << startup.report();
+            out.flush();
+        });
+    if(parser.isSet(quitOption))
+        QObject::connect(&startup, SIGNAL( finished() ), &app, SLOT( quit() ), Qt::QueuedConnection);
+
+    int result = app.exec();
+#ifdef TEXTEDITOR_TRACE
+    QString traceFile = QString::fromLocal8Bit(qgetenv("TEXTEDITOR_TRACE_FILE"));
+    TRACE_FLUSH(traceFile.isEmpty() ? QString("texteditor-trace.json") : traceFile);
+#endif
+#ifdef TEXTEDITOR_ALLOC_PROFILE
+    QString allocFile = QString::fromLocal8Bit(qgetenv("TEXTEDITOR_ALLOC_FILE"));
+    ALLOC_REPORT(allocFile.isEmpty() ? QString("texteditor-alloc.txt") : allocFile);
+#endif
+    return result;
 }
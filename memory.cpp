@@ -0,0 +1,57 @@
+#include "memory.h"
+
+MemoryUsage::MemoryUsage()
+{
+    for(int i = 0; i < CATEGORY_COUNT; ++i)
+        bytes_[i] = 0;
+}
+
+void MemoryUsage::add(const MemoryUsage &other)
+{
+    for(int i = 0; i < CATEGORY_COUNT; ++i)
+        bytes_[i] += other.bytes_[i];
+}
+
+void MemoryUsage::addAs(Category category, const MemoryUsage &other)
+{
+    bytes_[category] += other.total();
+}
+
+qint64 MemoryUsage::total() const
+{
+    qint64 result = 0;
+    for(int i = 0; i < CATEGORY_COUNT; ++i)
+        result += bytes_[i];
+    return result;
+}
+
+const char *MemoryUsage::categoryName(Category category)
+{
+    static const char *names[CATEGORY_COUNT] = {
+        "content", "styles", "lines", "slack", "metrics", "highlight", "index", "clipboard", "undo"
+    };
+    return names[category];
+}
+
+static QString megabytes(qint64 bytes)
+{
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1);
+}
+
+QString MemoryUsage::summary() const
+{
+    QStringList parts;
+    for(int i = 0; i < CATEGORY_COUNT; ++i)
+        if(bytes_[i])
+            parts << QString("%1 %2").arg(categoryName(Category(i))).arg(megabytes(bytes_[i]));
+    return QString("Memory %1 MB (%2)").arg(megabytes(total())).arg(parts.join(", "));
+}
+
+QString MemoryUsage::details() const
+{
+    QStringList lines;
+    for(int i = 0; i < CATEGORY_COUNT; ++i)
+        lines << QString("%1: %2 bytes").arg(categoryName(Category(i))).arg(bytes_[i]);
+    lines << QString("total: %1 bytes").arg(total());
+    return lines.join('\n');
+}
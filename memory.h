@@ -0,0 +1,28 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <QtCore>
+
+class MemoryUsage
+{
+public:
+    enum Category { Content, Styles, Lines, Slack, Metrics, Highlight, SearchIndex, Clipboard, Undo,
+                    CATEGORY_COUNT };
+
+    MemoryUsage();
+
+    inline qint64 bytes(Category category) const { return bytes_[category]; }
+    inline void add(Category category, qint64 bytes) { bytes_[category] += bytes; }
+    void add(const MemoryUsage& other);
+    void addAs(Category category, const MemoryUsage& other);
+    qint64 total() const;
+
+    static const char *categoryName(Category category);
+    QString summary() const;
+    QString details() const;
+
+private:
+    qint64 bytes_[CATEGORY_COUNT];
+};
+
+#endif
@@ -6,6 +6,7 @@ Menu::Menu(MenuComponents *components, QWidget *parent)
     this->components = components;
     fileMenu = new QMenu(tr("File"), this) ;
     editMenu = new QMenu(tr("Edit"), this);
+    viewMenu = new QMenu(tr("View"), this);
     contextMenu = new QMenu(this);
     createMenu();
     createContextMenu();
@@ -26,8 +27,13 @@ void Menu::createMenu()
 
     components->addEditActions(editMenu);
     editMenu->addSeparator();
+    components->addFindActions(editMenu);
+    editMenu->addSeparator();
     components->addDropDawnFontActions(editMenu);
     addMenu(editMenu);
+
+    components->addViewActions(viewMenu);
+    addMenu(viewMenu);
 }
 
 void Menu::createContextMenu()
@@ -0,0 +1,25 @@
+QT += core gui \
+      xml \
+      widgets
+
+TEMPLATE = app
+TARGET = textreplay
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../corelib.pri)
+
+HEADERS += \
+    ../carriage.h \
+    ../field.h \
+    ../inputtrace.h \
+    ../latency.h \
+    ../startup.h
+
+SOURCES += \
+    ../carriage.cpp \
+    ../field.cpp \
+    ../inputtrace.cpp \
+    ../latency.cpp \
+    ../startup.cpp \
+    textreplay.cpp
@@ -0,0 +1,90 @@
+#include <QtWidgets>
+
+#include "field.h"
+#include "inputtrace.h"
+
+static QFont style_font(const QFont& base, int style)
+{
+    QFont font = base;
+    font.setBold(style & 1);
+    font.setItalic(style & 2);
+    font.setPointSize(base.pointSize() + (style >> 2) * 2);
+    return font;
+}
+
+static Text *synthetic_text(const QFont& base, int lines, int lineLength, int styles)
+{
+    enum { RUN_LENGTH = 8 };
+
+    QVector<QFont> fonts;
+    for(int i = 0; i < qMax(styles, 1); ++i)
+        fonts.append(style_font(base, i));
+
+    Text *text = new Text;
+    int height = QFontMetrics(base).height();
+    for(int y = 0; y < lines; ++y){
+        Line line(height, text->arena());
+        for(int x = 0; x < lineLength; ++x){
+            const QFont& font = fonts.at((x / RUN_LENGTH + y) % fonts.size());
+            line.push_back(Symbol(font, QChar(x % 7 == 6 ? ' ' : 'a' + (x + y) % 26)));
+        }
+        line.recountHeight();
+        text->push_back(line);
+    }
+    return text;
+}
+
+int main(int argc, char *argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a recorded input trace into a text field.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "Input trace recorded with View > Record Input.");
+    QCommandLineOption linesOption("lines", "Lines in the synthetic document.", "count", "10000");
+    QCommandLineOption lengthOption("line-length", "Symbols per line.", "count", "80");
+    QCommandLineOption stylesOption("styles", "Distinct styles mixed in each line.", "count", "1");
+    QCommandLineOption speedOption("speed", "Replay speed factor; 0 replays without delays.", "factor", "1");
+    QCommandLineOption csvOption("csv", "Write the latency breakdown to a CSV file.", "file");
+    parser.addOption(linesOption);
+    parser.addOption(lengthOption);
+    parser.addOption(stylesOption);
+    parser.addOption(speedOption);
+    parser.addOption(csvOption);
+    parser.process(app);
+
+    if(parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    InputTrace trace;
+    if(!trace.load(parser.positionalArguments().first())){
+        qWarning("Cannot read %s", qPrintable(parser.positionalArguments().first()));
+        return 1;
+    }
+
+    QFont font("Courier", 12);
+    TextField field(font);
+    field.setTextEditorView(Qt::white);
+    QScopedPointer<Text> text(synthetic_text(font, parser.value(linesOption).toInt(),
+                                             parser.value(lengthOption).toInt(),
+                                             parser.value(stylesOption).toInt()));
+    field.setText(text.data());
+    field.show();
+
+    InputReplayer replayer(&field);
+    replayer.setSpeed(parser.value(speedOption).toDouble());
+    replayer.replay(trace);
+
+    QTextStream out(stdout);
+    out << trace.size() << " events over " << trace.duration() / 1000000 << " ms recorded\n"
+        << replayer.report();
+
+    if(parser.isSet(csvOption) && !LatencyMonitor::instance().dump(parser.value(csvOption))){
+        qWarning("Cannot write %s", qPrintable(parser.value(csvOption)));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "scheduler.h"
+
+IdleScheduler::IdleScheduler(QObject *parent)
+    : QObject(parent), runningOwner_(Q_NULLPTR), runningKind_(0), runningCancelled_(false), pending_(0)
+{
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    connect(timer_, SIGNAL( timeout() ), SLOT( on_tick() ) );
+    lastInput_.start();
+    waiting_.start();
+    if(qApp)
+        qApp->installEventFilter(this);
+}
+
+IdleScheduler& IdleScheduler::instance()
+{
+    static IdleScheduler *scheduler = new IdleScheduler(qApp);
+    return *scheduler;
+}
+
+void IdleScheduler::post(QObject *owner, int kind, Priority priority, const Task &task)
+{
+    remove(owner, kind, false);
+    Entry entry;
+    entry.owner = owner;
+    entry.kind = kind;
+    entry.task = task;
+    if(!pending_)
+        waiting_.restart();
+    queues_[priority].append(entry);
+    ++pending_;
+    connect(owner, SIGNAL( destroyed(QObject*) ), SLOT( on_owner_destroyed(QObject*) ),
+            Qt::UniqueConnection);
+    schedule();
+}
+
+void IdleScheduler::cancel(QObject *owner, int kind)
+{
+    remove(owner, kind, false);
+}
+
+void IdleScheduler::cancelAll(QObject *owner)
+{
+    remove(owner, 0, true);
+}
+
+bool IdleScheduler::isPending(QObject *owner, int kind) const
+{
+    for(int p = 0; p < PRIORITY_COUNT; ++p)
+        foreach (const Entry& entry, queues_[p])
+            if(entry.owner == owner && entry.kind == kind)
+                return true;
+    return false;
+}
+
+bool IdleScheduler::isIdle() const
+{
+    return lastInput_.elapsed() >= INPUT_QUIET;
+}
+
+bool IdleScheduler::eventFilter(QObject *watched, QEvent *event)
+{
+    switch(event->type()){
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+    case QEvent::InputMethod:
+        lastInput_.restart();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void IdleScheduler::on_tick()
+{
+    if(!isIdle() && waiting_.elapsed() < MAX_DEFER){
+        timer_->start(INPUT_QUIET - lastInput_.elapsed());
+        return;
+    }
+
+    IdleDeadline frame(FRAME_BUDGET);
+    while(pending_ && !frame.expired()){
+        int p = 0;
+        while(queues_[p].isEmpty())
+            ++p;
+        Entry entry = queues_[p].takeFirst();
+        --pending_;
+
+        runningOwner_ = entry.owner;
+        runningKind_ = entry.kind;
+        runningCancelled_ = false;
+        bool done = entry.task(IdleDeadline(int(frame.timeRemaining())));
+        runningOwner_ = Q_NULLPTR;
+
+        if(!done && !runningCancelled_){
+            queues_[p].append(entry);
+            ++pending_;
+        }
+    }
+    waiting_.restart();
+    schedule();
+}
+
+void IdleScheduler::on_owner_destroyed(QObject *owner)
+{
+    remove(owner, 0, true);
+}
+
+bool IdleScheduler::remove(QObject *owner, int kind, bool all)
+{
+    bool removed = false;
+    if(runningOwner_ == owner && (all || runningKind_ == kind)){
+        runningCancelled_ = true;
+        removed = true;
+    }
+    for(int p = 0; p < PRIORITY_COUNT; ++p){
+        QList<Entry>& queue = queues_[p];
+        for(int i = queue.size() - 1; i >= 0; --i){
+            if(queue.at(i).owner == owner && (all || queue.at(i).kind == kind)){
+                queue.removeAt(i);
+                --pending_;
+                removed = true;
+            }
+        }
+    }
+    if(!pending_)
+        timer_->stop();
+    return removed;
+}
+
+void IdleScheduler::schedule()
+{
+    if(pending_ && !timer_->isActive())
+        timer_->start(isIdle() ? 0 : INPUT_QUIET - lastInput_.elapsed());
+}
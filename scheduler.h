@@ -0,0 +1,74 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QtCore>
+
+#include <functional>
+
+class IdleDeadline
+{
+public:
+    explicit IdleDeadline(int budget) : budget_(budget) { timer_.start(); }
+
+    inline int budget() const { return budget_; }
+    inline qint64 timeRemaining() const { return qMax<qint64>(0, budget_ - timer_.elapsed()); }
+    inline bool expired() const { return timer_.elapsed() >= budget_; }
+
+private:
+    QElapsedTimer timer_;
+    int budget_;
+};
+
+class IdleScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority { HighPriority, NormalPriority, LowPriority, PRIORITY_COUNT };
+    enum { FRAME_BUDGET = 4, INPUT_QUIET = 40, MAX_DEFER = 250 };
+
+    typedef std::function<bool (const IdleDeadline&)> Task;
+
+    static IdleScheduler& instance();
+
+    void post(QObject *owner, int kind, Priority priority, const Task& task);
+    void cancel(QObject *owner, int kind);
+    void cancelAll(QObject *owner);
+    bool isPending(QObject *owner, int kind) const;
+
+    inline int pendingCount() const { return pending_; }
+    bool isIdle() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event);
+
+private slots:
+    void on_tick();
+    void on_owner_destroyed(QObject *owner);
+
+private:
+    struct Entry
+    {
+        QObject *owner;
+        int kind;
+        Task task;
+    };
+
+    explicit IdleScheduler(QObject *parent = Q_NULLPTR);
+
+    bool remove(QObject *owner, int kind, bool all);
+    void schedule();
+
+    QList<Entry> queues_[PRIORITY_COUNT];
+    QElapsedTimer lastInput_;
+    QElapsedTimer waiting_;
+    QTimer *timer_;
+    QObject *runningOwner_;
+    int runningKind_;
+    bool runningCancelled_;
+    int pending_;
+
+    Q_DISABLE_COPY(IdleScheduler)
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "search.h"
+#include "trigram.h"
+
+LineMatcher::LineMatcher(const SearchQuery &query)
+    : query_(query)
+{
+    if(query_.regex){
+        QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption;
+        if(query_.cs == Qt::CaseInsensitive)
+            options |= QRegularExpression::CaseInsensitiveOption;
+        regex_ = QRegularExpression(query_.pattern, options);
+        regex_.optimize();
+    }
+}
+
+bool LineMatcher::isValid() const
+{
+    if(query_.isEmpty())
+        return false;
+    return !query_.regex || regex_.isValid();
+}
+
+void LineMatcher::match(const Line &line, int y, SearchMatches &out) const
+{
+    if(query_.regex){
+        QRegularExpressionMatchIterator it = regex_.globalMatch(line.text());
+        while(it.hasNext()){
+            QRegularExpressionMatch m = it.next();
+            if(m.capturedLength())
+                out.append(SearchMatch(y, m.capturedStart(), m.capturedLength()));
+        }
+        return;
+    }
+
+    int n = query_.pattern.size();
+    int pos = line.indexOf(query_.pattern, 0, query_.cs);
+    while(pos >= 0){
+        out.append(SearchMatch(y, pos, n));
+        pos = line.indexOf(query_.pattern, pos + n, query_.cs);
+    }
+}
+
+SearchTask::SearchTask(int id, const TextSnapshot &text, const SearchQuery &query,
+                       TrigramIndex *index, QObject *parent)
+    : QObject(parent), id_(id), text_(text), query_(query), index_(index)
+{
+}
+
+void SearchTask::run(const CancelToken &token)
+{
+    LineMatcher matcher(query_);
+    SearchMatches batch;
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<int> lines;
+    bool narrowed = index_ && index_->candidates(text_, query_, lines);
+    int count = narrowed ? lines.size() : text_.length();
+    for(int i = 0; i < count; ++i){
+        if(token.isCancelled())
+            return;
+        int y = narrowed ? lines.at(i) : i;
+        matcher.match(text_.at(y), y, batch);
+        if(batch.size() >= BATCH_SIZE || (!batch.isEmpty() && timer.elapsed() >= BATCH_INTERVAL)){
+            emit matchesFound(id_, batch);
+            batch.clear();
+            timer.restart();
+        }
+    }
+    if(!batch.isEmpty())
+        emit matchesFound(id_, batch);
+    emit searchFinished(id_);
+}
+
+FindEngine::FindEngine(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<SearchMatches>("SearchMatches");
+    indexId_ = 0;
+    id_ = 0;
+    valid_ = false;
+    version_ = 0;
+}
+
+FindEngine::~FindEngine()
+{
+    cancel();
+    setIndexEnabled(false);
+}
+
+void FindEngine::find(const TextSnapshot &text, const SearchQuery &query)
+{
+    cancel();
+    matches_.clear();
+    query_ = query;
+    version_ = text.version();
+    valid_ = LineMatcher(query).isValid();
+    if(!valid_){
+        emit finished(0);
+        return;
+    }
+
+    // The job shares the task and the index, so a cancelled search can wind
+    // down on its own; its late signals carry a stale id and are dropped.
+    QSharedPointer<SearchTask> task(new SearchTask(id_, text, query, index_.data()), &QObject::deleteLater);
+    QSharedPointer<TrigramIndex> index = index_;
+    connect(task.data(), SIGNAL( matchesFound(int, SearchMatches) ),
+            SLOT( on_matches_found(int, SearchMatches) ), Qt::QueuedConnection);
+    connect(task.data(), SIGNAL( searchFinished(int) ), SLOT( on_search_finished(int) ), Qt::QueuedConnection);
+    task_ = task;
+    job_ = JobPool::instance().submit(JobPool::Visible,
+                                      [task, index](const CancelToken& token) { task->run(token); });
+}
+
+void FindEngine::cancel()
+{
+    ++id_;
+    job_.cancel();
+    task_.clear();
+    job_ = JobHandle();
+}
+
+void FindEngine::setIndexEnabled(bool enabled)
+{
+    if(enabled == isIndexEnabled())
+        return;
+    cancel();
+    cancel_index();
+    if(enabled)
+        index_ = QSharedPointer<TrigramIndex>(new TrigramIndex);
+    else
+        index_.clear();
+}
+
+void FindEngine::updateIndex(const TextSnapshot &text)
+{
+    if(!index_)
+        return;
+    cancel_index();
+    QSharedPointer<IndexTask> task(new IndexTask(indexId_, index_.data(), text), &QObject::deleteLater);
+    QSharedPointer<TrigramIndex> index = index_;
+    connect(task.data(), SIGNAL( progress(int, int) ), SLOT( on_index_progress(int, int) ), Qt::QueuedConnection);
+    connect(task.data(), SIGNAL( indexFinished(int) ), SLOT( on_index_finished(int) ), Qt::QueuedConnection);
+    indexTask_ = task;
+    indexJob_ = JobPool::instance().submit(JobPool::Background,
+                                           [task, index](const CancelToken& token) { task->run(token); });
+}
+
+qint64 FindEngine::indexMemory() const
+{
+    return index_ ? index_->memoryUsage() : 0;
+}
+
+SearchMatches FindEngine::findAll(const TextSnapshot &text, const SearchQuery &query)
+{
+    SearchMatches matches;
+    LineMatcher matcher(query);
+    if(!matcher.isValid())
+        return matches;
+    for(int i = 0; i < text.length(); ++i)
+        matcher.match(text.at(i), i, matches);
+    return matches;
+}
+
+int FindEngine::next(const QPoint &pos) const
+{
+    if(matches_.isEmpty())
+        return -1;
+    SearchMatches::const_iterator it = std::lower_bound(matches_.begin(), matches_.end(),
+                                                        SearchMatch(pos.y(), pos.x(), 0));
+    return it == matches_.end() ? 0 : it - matches_.begin();
+}
+
+int FindEngine::previous(const QPoint &pos) const
+{
+    if(matches_.isEmpty())
+        return -1;
+    SearchMatches::const_iterator it = std::lower_bound(matches_.begin(), matches_.end(),
+                                                        SearchMatch(pos.y(), pos.x(), 0));
+    return it == matches_.begin() ? matches_.size() - 1 : it - matches_.begin() - 1;
+}
+
+void FindEngine::on_matches_found(int id, const SearchMatches &matches)
+{
+    if(id != id_)
+        return;
+    matches_ += matches;
+    emit matchesFound(matches_.size());
+}
+
+void FindEngine::on_index_progress(int id, int percent)
+{
+    if(id == indexId_)
+        emit indexProgress(percent);
+}
+
+void FindEngine::on_index_finished(int id)
+{
+    if(id != indexId_ || !indexTask_)
+        return;
+    indexTask_.clear();
+    indexJob_ = JobHandle();
+    emit indexReady();
+}
+
+void FindEngine::cancel_index()
+{
+    ++indexId_;
+    indexJob_.cancel();
+    indexTask_.clear();
+    indexJob_ = JobHandle();
+}
+
+void FindEngine::on_search_finished(int id)
+{
+    if(id != id_ || !task_)
+        return;
+    task_.clear();
+    job_ = JobHandle();
+    emit finished(matches_.size());
+}
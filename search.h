@@ -0,0 +1,143 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <QtCore>
+
+#include "char.h"
+#include "jobs.h"
+
+class TrigramIndex;
+class IndexTask;
+
+struct SearchMatch
+{
+    SearchMatch() : line(0), column(0), length(0) {}
+    SearchMatch(int l, int c, int n) : line(l), column(c), length(n) {}
+
+    inline QPoint begin() const { return QPoint(column, line); }
+    inline QPoint end() const { return QPoint(column + length, line); }
+
+    int line;
+    int column;
+    int length;
+};
+
+Q_DECLARE_TYPEINFO(SearchMatch, Q_PRIMITIVE_TYPE);
+
+inline bool operator<(const SearchMatch& a, const SearchMatch& b)
+{
+    return a.line < b.line || (a.line == b.line && a.column < b.column);
+}
+
+typedef QVector<SearchMatch> SearchMatches;
+
+struct SearchQuery
+{
+    SearchQuery() : cs(Qt::CaseSensitive), regex(false) {}
+
+    inline bool isEmpty() const { return pattern.isEmpty(); }
+    inline bool operator==(const SearchQuery& other) const
+    {
+        return pattern == other.pattern && cs == other.cs && regex == other.regex;
+    }
+    inline bool operator!=(const SearchQuery& other) const { return !(*this == other); }
+
+    QString pattern;
+    Qt::CaseSensitivity cs;
+    bool regex;
+};
+
+class LineMatcher
+{
+public:
+    explicit LineMatcher(const SearchQuery& query);
+
+    bool isValid() const;
+    void match(const Line& line, int y, SearchMatches& out) const;
+
+private:
+    SearchQuery query_;
+    QRegularExpression regex_;
+};
+
+class SearchTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    SearchTask(int id, const TextSnapshot& text, const SearchQuery& query,
+               TrigramIndex *index = Q_NULLPTR, QObject *parent = Q_NULLPTR);
+
+    void run(const CancelToken& token);
+
+signals:
+    void matchesFound(int id, const SearchMatches& matches);
+    void searchFinished(int id);
+
+private:
+    enum { BATCH_SIZE = 4096, BATCH_INTERVAL = 50 };
+
+    int id_;
+    TextSnapshot text_;
+    SearchQuery query_;
+    TrigramIndex *index_;
+};
+
+class FindEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindEngine(QObject *parent = Q_NULLPTR);
+    ~FindEngine();
+
+    void find(const TextSnapshot& text, const SearchQuery& query);
+    void cancel();
+
+    inline bool isRunning() const { return !task_.isNull(); }
+    inline bool isValid() const { return valid_; }
+    inline const SearchQuery& query() const { return query_; }
+    inline quint64 version() const { return version_; }
+    inline const SearchMatches& matches() const { return matches_; }
+
+    static SearchMatches findAll(const TextSnapshot& text, const SearchQuery& query);
+
+    void setIndexEnabled(bool enabled);
+    inline bool isIndexEnabled() const { return !index_.isNull(); }
+    void updateIndex(const TextSnapshot& text);
+    qint64 indexMemory() const;
+
+    int next(const QPoint& pos) const;
+    int previous(const QPoint& pos) const;
+
+signals:
+    void matchesFound(int count);
+    void finished(int count);
+    void indexProgress(int percent);
+    void indexReady();
+
+private slots:
+    void on_matches_found(int id, const SearchMatches& matches);
+    void on_search_finished(int id);
+    void on_index_progress(int id, int percent);
+    void on_index_finished(int id);
+
+private:
+    void cancel_index();
+
+    QSharedPointer<SearchTask> task_;
+    JobHandle job_;
+    QSharedPointer<TrigramIndex> index_;
+    QSharedPointer<IndexTask> indexTask_;
+    JobHandle indexJob_;
+    int indexId_;
+    int id_;
+    bool valid_;
+    SearchQuery query_;
+    quint64 version_;
+    SearchMatches matches_;
+};
+
+Q_DECLARE_METATYPE(SearchMatches)
+
+#endif
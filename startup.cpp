@@ -0,0 +1,97 @@
+#include "startup.h"
+
+#include <algorithm>
+
+static QElapsedTimer started_clock()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+// Started during static initialization, so it also covers the time spent
+// before main() in constructors of other translation units.
+static const QElapsedTimer processClock = started_clock();
+
+StartupProfiler::StartupProfiler()
+{
+    for(int i = 0; i < MILESTONE_COUNT; ++i)
+        stamps_[i] = -1;
+    fileExpected_ = false;
+    finished_ = false;
+}
+
+StartupProfiler& StartupProfiler::instance()
+{
+    static StartupProfiler *profiler = new StartupProfiler;
+    return *profiler;
+}
+
+const char *StartupProfiler::milestoneName(Milestone milestone)
+{
+    static const char *names[MILESTONE_COUNT] = {
+        "main", "application", "menu", "toolbar", "text field",
+        "window", "shown", "first paint", "first idle", "file loaded", "file painted"
+    };
+    return names[milestone];
+}
+
+void StartupProfiler::mark(Milestone milestone)
+{
+    if(stamps_[milestone] >= 0)
+        return;
+    stamps_[milestone] = processClock.nsecsElapsed();
+    if(milestone == FirstPaint)
+        QTimer::singleShot(0, this, SLOT( on_idle() ) );
+    check_finished();
+}
+
+void StartupProfiler::framePainted()
+{
+    if(finished_)
+        return;
+    mark(FirstPaint);
+    if(stamps_[FileLoaded] >= 0)
+        mark(FilePainted);
+}
+
+void StartupProfiler::setFileExpected(bool expected)
+{
+    fileExpected_ = expected;
+    check_finished();
+}
+
+void StartupProfiler::on_idle()
+{
+    mark(FirstIdle);
+}
+
+void StartupProfiler::check_finished()
+{
+    if(finished_ || stamps_[FirstIdle] < 0 || (fileExpected_ && stamps_[FilePainted] < 0))
+        return;
+    finished_ = true;
+    emit finished();
+}
+
+QString StartupProfiler::report() const
+{
+    QString report;
+    QTextStream out(&report);
+    out << "milestone,ms,delta ms\n";
+    QVector<int> reached;
+    for(int i = 0; i < MILESTONE_COUNT; ++i)
+        if(stamps_[i] >= 0)
+            reached.append(i);
+    std::stable_sort(reached.begin(), reached.end(), [this](int a, int b) {
+        return stamps_[a] < stamps_[b];
+    });
+    qint64 previous = 0;
+    foreach (int i, reached) {
+        out << milestoneName(Milestone(i)) << ','
+            << QString::number(stamps_[i] / 1e6, 'f', 2) << ','
+            << QString::number((stamps_[i] - previous) / 1e6, 'f', 2) << '\n';
+        previous = stamps_[i];
+    }
+    return report;
+}
@@ -0,0 +1,46 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <QtCore>
+
+class StartupProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Milestone {
+        MainEntered, ApplicationCreated, MenuCreated, ToolBarCreated, TextFieldCreated,
+        WindowCreated, WindowShown, FirstPaint, FirstIdle, FileLoaded, FilePainted,
+        MILESTONE_COUNT
+    };
+
+    static StartupProfiler& instance();
+    static const char *milestoneName(Milestone milestone);
+
+    void mark(Milestone milestone);
+    void framePainted();
+    void setFileExpected(bool expected);
+
+    inline bool isFinished() const { return finished_; }
+    inline qint64 elapsed(Milestone milestone) const { return stamps_[milestone]; }
+    QString report() const;
+
+signals:
+    void finished();
+
+private slots:
+    void on_idle();
+
+private:
+    StartupProfiler();
+
+    void check_finished();
+
+    qint64 stamps_[MILESTONE_COUNT];
+    bool fileExpected_;
+    bool finished_;
+
+    Q_DISABLE_COPY(StartupProfiler)
+};
+
+#endif
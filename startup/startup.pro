@@ -0,0 +1,10 @@
+QT += core
+QT -= gui
+
+TEMPLATE = app
+TARGET = textstartup
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += \
+    textstartup.cpp
@@ -0,0 +1,117 @@
+#include <QtCore>
+
+#include <algorithm>
+
+struct Run
+{
+    QStringList milestones;
+    QHash<QString, double> times;
+};
+
+static QString default_binary()
+{
+#ifdef Q_OS_WIN
+    return QCoreApplication::applicationDirPath() + "/../app/TextEditor.exe";
+#else
+    return QCoreApplication::applicationDirPath() + "/../app/TextEditor";
+#endif
+}
+
+static bool launch(const QString& binary, const QStringList& arguments, Run& run)
+{
+    enum { TIMEOUT = 60000 };
+
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    QElapsedTimer wall;
+    wall.start();
+    process.start(binary, arguments);
+    if(!process.waitForFinished(TIMEOUT) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0){
+        process.kill();
+        return false;
+    }
+    double total = wall.nsecsElapsed() / 1e6;
+
+    QList<QByteArray> rows = process.readAllStandardOutput().split('\n');
+    for(int i = 1; i < rows.size(); ++i){
+        QList<QByteArray> fields = rows.at(i).trimmed().split(',');
+        if(fields.size() != 3)
+            continue;
+        QString name = QString::fromUtf8(fields.at(0));
+        run.milestones.append(name);
+        run.times.insert(name, fields.at(1).toDouble());
+    }
+    run.milestones.append("process exit");
+    run.times.insert("process exit", total);
+    return run.milestones.size() > 1;
+}
+
+static double median(QVector<double> values)
+{
+    if(values.isEmpty())
+        return -1;
+    std::sort(values.begin(), values.end());
+    int middle = values.size() / 2;
+    return values.size() % 2 ? values.at(middle) : (values.at(middle - 1) + values.at(middle)) / 2;
+}
+
+static QString format_ms(double ms)
+{
+    return ms < 0 ? QString("-") : QString::number(ms, 'f', 2);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Launches the editor on the offscreen platform and reports startup milestones.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "File to open on startup.", "[file]");
+    QCommandLineOption runsOption("runs", "Launches; the first is reported as cold.", "count", "10");
+    QCommandLineOption binaryOption("binary", "Editor executable.", "path", default_binary());
+    QCommandLineOption csvOption("csv", "Write every run's milestones to a CSV file.", "file");
+    parser.addOption(runsOption);
+    parser.addOption(binaryOption);
+    parser.addOption(csvOption);
+    parser.process(app);
+
+    QStringList arguments;
+    arguments << "-platform" << "offscreen" << "--startup-profile" << "--quit-after-startup";
+    if(!parser.positionalArguments().isEmpty())
+        arguments << QFileInfo(parser.positionalArguments().first()).absoluteFilePath();
+
+    QVector<Run> runs(qMax(parser.value(runsOption).toInt(), 1));
+    for(int i = 0; i < runs.size(); ++i)
+        if(!launch(parser.value(binaryOption), arguments, runs[i])){
+            qWarning("Run %d of %s failed", i + 1, qPrintable(parser.value(binaryOption)));
+            return 1;
+        }
+
+    QTextStream out(stdout);
+    out.setFieldAlignment(QTextStream::AlignLeft);
+    out << qSetFieldWidth(16) << "milestone" << "cold ms" << "warm median ms"
+        << qSetFieldWidth(0) << '\n';
+    foreach (const QString& milestone, runs.first().milestones) {
+        QVector<double> warm;
+        for(int i = 1; i < runs.size(); ++i)
+            if(runs.at(i).times.contains(milestone))
+                warm.append(runs.at(i).times.value(milestone));
+        out << qSetFieldWidth(16) << milestone << format_ms(runs.first().times.value(milestone))
+            << format_ms(median(warm)) << qSetFieldWidth(0) << '\n';
+    }
+
+    if(parser.isSet(csvOption)){
+        QFile csv(parser.value(csvOption));
+        if(!csv.open(QIODevice::WriteOnly | QIODevice::Text)){
+            qWarning("Cannot write %s", qPrintable(parser.value(csvOption)));
+            return 1;
+        }
+        QTextStream rows(&csv);
+        rows << "run,milestone,ms\n";
+        for(int i = 0; i < runs.size(); ++i)
+            foreach (const QString& milestone, runs.at(i).milestones)
+                rows << i + 1 << ',' << milestone << ',' << format_ms(runs.at(i).times.value(milestone)) << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT += core gui \
+      xml \
+      testlib
+
+TEMPLATE = app
+TARGET = tst_undo
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../corelib.pri)
+
+SOURCES += \
+    tst_undo.cpp
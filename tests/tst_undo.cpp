@@ -0,0 +1,193 @@
+#include <QtTest>
+
+#include "char.h"
+#include "undo.h"
+
+class UndoTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void typingCoalesces();
+    void backspaceCoalesces();
+    void sealEndsTyping();
+    void gapEndsTyping();
+    void groupIsOneStep();
+    void editClearsRedo();
+    void undoRedoRoundTrip();
+    void trimKeepsBudget();
+
+private:
+    void type(const QString& chars, QPoint& pos);
+    QString contents() const;
+    inline UndoStack *history() const { return text_->undoStack(); }
+
+    QFont font_;
+    Text *text_;
+};
+
+void UndoTest::initTestCase()
+{
+    font_ = QFont("Courier", 12);
+}
+
+void UndoTest::init()
+{
+    text_ = new Text(QFontMetrics(font_).height());
+    text_->setUndoEnabled(true);
+}
+
+void UndoTest::cleanup()
+{
+    delete text_;
+}
+
+void UndoTest::type(const QString &chars, QPoint &pos)
+{
+    for(int i = 0; i < chars.size(); ++i){
+        text_->insert(pos.x(), pos.y(), Symbol(font_, chars.at(i)));
+        pos.rx()++;
+    }
+}
+
+QString UndoTest::contents() const
+{
+    QStringList lines;
+    for(int i = 0; i < text_->length(); ++i)
+        lines.append(text_->at(i).text());
+    return lines.join('\n');
+}
+
+void UndoTest::typingCoalesces()
+{
+    QPoint pos(0, 0);
+    type("hello", pos);
+    QCOMPARE(history()->undoCount(), 1);
+
+    QVERIFY(text_->undo(pos));
+    QCOMPARE(contents(), QString());
+}
+
+void UndoTest::backspaceCoalesces()
+{
+    QPoint pos(0, 0);
+    type("hello", pos);
+    history()->seal();
+    text_->eraseSymbol(0, 5, pos);
+    text_->eraseSymbol(0, 4, pos);
+    text_->eraseSymbol(0, 3, pos);
+    QCOMPARE(contents(), QString("he"));
+    QCOMPARE(history()->undoCount(), 2);
+
+    QVERIFY(text_->undo(pos));
+    QCOMPARE(contents(), QString("hello"));
+}
+
+void UndoTest::sealEndsTyping()
+{
+    QPoint pos(0, 0);
+    type("ab", pos);
+    history()->seal();
+    type("cd", pos);
+    QCOMPARE(history()->undoCount(), 2);
+
+    QVERIFY(text_->undo(pos));
+    QCOMPARE(contents(), QString("ab"));
+}
+
+void UndoTest::gapEndsTyping()
+{
+    QPoint pos(0, 0);
+    type("abcd", pos);
+    pos = QPoint(1, 0);
+    type("x", pos);
+    QCOMPARE(history()->undoCount(), 2);
+}
+
+void UndoTest::groupIsOneStep()
+{
+    QPoint pos(0, 0);
+    type("hello", pos);
+    {
+        UndoGroup group(history());
+        text_->deleteText(QPoint(1, 0), QPoint(4, 0));
+        pos = QPoint(1, 0);
+        type("ipp", pos);
+    }
+    QCOMPARE(contents(), QString("hippo"));
+    QCOMPARE(history()->undoCount(), 2);
+
+    // The group is sealed, so typing after it starts a new step.
+    type("s", pos);
+    QCOMPARE(history()->undoCount(), 3);
+
+    QVERIFY(text_->undo(pos));
+    QVERIFY(text_->undo(pos));
+    QCOMPARE(contents(), QString("hello"));
+}
+
+void UndoTest::editClearsRedo()
+{
+    QPoint pos(0, 0);
+    type("ab", pos);
+    QVERIFY(text_->undo(pos));
+    QVERIFY(history()->canRedo());
+
+    pos = QPoint(0, 0);
+    type("c", pos);
+    QVERIFY(!history()->canRedo());
+    QVERIFY(!text_->redo(pos));
+    QCOMPARE(contents(), QString("c"));
+}
+
+void UndoTest::undoRedoRoundTrip()
+{
+    QPoint pos(0, 0);
+    type("one", pos);
+    text_->breakLine(pos);
+    type("two", pos);
+    QString edited = contents();
+
+    while(text_->undo(pos))
+        ;
+    QCOMPARE(contents(), QString());
+    while(text_->redo(pos))
+        ;
+    QCOMPARE(contents(), edited);
+}
+
+void UndoTest::trimKeepsBudget()
+{
+    enum { EDITS = 200 };
+
+    history()->setBudget(4096);
+    QPoint pos(0, 0);
+    for(int i = 0; i < EDITS; ++i){
+        type(QString(QChar('a' + i % 26)), pos);
+        history()->seal();
+    }
+    QVERIFY(history()->bytes() <= history()->budget());
+    int kept = history()->undoCount();
+    QVERIFY(kept > 0);
+    QVERIFY(kept < EDITS);
+
+    // The oldest steps are the ones dropped.
+    while(text_->undo(pos))
+        ;
+    QCOMPARE(contents().size(), EDITS - kept);
+}
+
+int main(int argc, char *argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    UndoTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_undo.moc"
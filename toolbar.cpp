@@ -17,11 +17,17 @@ EditToolBar::~EditToolBar()
 void EditToolBar::changeToolBarFonts(const QFont& f)
 {
     sizeBox->setCurrentText(QString::number(f.pointSize()));
-    fontBox->setCurrentText(f.family());
+    fontFamily = f.family();
+    fontBox->setCurrentText(fontFamily);
     components->fontBoldAction->setChecked(f.bold());
     components->fontItalicAction->setChecked(f.italic());
 }
 
+void EditToolBar::restoreFontFamily()
+{
+    fontBox->setCurrentText(fontFamily);
+}
+
 void EditToolBar::createToolBar()
 {
     components->addFileActions(this);
@@ -29,16 +35,27 @@ void EditToolBar::createToolBar()
     components->addEditActions(this);
     addSeparator();
 
-    fontBox->addItems(components->getFontList());
+    QListView *fontView = new QListView(fontBox);
+    fontView->setUniformItemSizes(true);
+    fontBox->setEditable(true);
+    fontBox->setInsertPolicy(QComboBox::NoInsert);
+    fontBox->setView(fontView);
+    fontBox->setModel(components->fontModel);
+    QCompleter *fontCompleter = new QCompleter(components->fontModel, fontBox);
+    fontCompleter->setCaseSensitivity(Qt::CaseInsensitive);
+    fontCompleter->setFilterMode(Qt::MatchContains);
+    fontBox->setCompleter(fontCompleter);
     addWidget(fontBox);
+    connect(components->fontModel, SIGNAL( familiesLoaded() ), SLOT( restoreFontFamily() ) );
 
     #ifdef __linux__
-        fontBox->setCurrentText("Ubuntu");
+        fontFamily = "Ubuntu";
     #else
     #ifdef __WIN32__
-        fontBox->setCurrentText("Serif");
+        fontFamily = "Serif";
     #endif
     #endif
+    fontBox->setCurrentText(fontFamily);
 
     sizeBox->addItems(components->getFontSizeList());
     addWidget(sizeBox);
@@ -22,6 +22,9 @@ public:
 public slots:
     void changeToolBarFonts(const QFont&);
 
+private slots:
+    void restoreFontFamily();
+
 protected:
     void createToolBar();
 
@@ -29,6 +32,7 @@ private:
     MenuComponents *components;
     QComboBox *fontBox;
     QComboBox *sizeBox;
+    QString fontFamily;
 };
 
 
@@ -0,0 +1,93 @@
+#include "trace.h"
+
+#ifdef TEXTEDITOR_TRACE
+
+QVector<TraceEvent> TraceRing::events() const
+{
+    quint64 head = head_.loadAcquire();
+    quint64 first = head > CAPACITY ? head - CAPACITY : 0;
+    QVector<TraceEvent> result;
+    result.reserve(int(head - first));
+    for(quint64 i = first; i < head; ++i)
+        result.append(events_[i & (CAPACITY - 1)]);
+
+    quint64 current = head_.loadAcquire();
+    if(current + 1 > first + CAPACITY){
+        int torn = int(qMin<quint64>(current + 1 - CAPACITY - first, result.size()));
+        result.remove(0, torn);
+    }
+    return result;
+}
+
+Tracer& Tracer::instance()
+{
+    static Tracer *tracer = new Tracer;
+    return *tracer;
+}
+
+static QElapsedTimer started_clock()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+qint64 Tracer::now()
+{
+    static const QElapsedTimer clock = started_clock();
+    return clock.nsecsElapsed();
+}
+
+TraceRing *Tracer::register_thread()
+{
+    QMutexLocker locker(&mutex_);
+    QString name = QThread::currentThread() ? QThread::currentThread()->objectName() : QString();
+    if(name.isEmpty())
+        name = rings_.isEmpty() ? QString("main") : QString("thread %1").arg(rings_.size());
+    TraceRing *ring = new TraceRing(rings_.size() + 1, name);
+    rings_.append(ring);
+    return ring;
+}
+
+static QString json_string(const QString& text)
+{
+    QString result = text;
+    result.replace('\\', "\\\\");
+    result.replace('"', "\\\"");
+    return QString("\"%1\"").arg(result);
+}
+
+bool Tracer::writeJson(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+
+    QList<TraceRing*> rings;
+    {
+        QMutexLocker locker(&mutex_);
+        rings = rings_;
+    }
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    foreach (TraceRing *ring, rings) {
+        out << (first ? "\n" : ",\n")
+            << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid()
+            << ",\"args\":{\"name\":" << json_string(ring->name()) << "}}";
+        first = false;
+        QVector<TraceEvent> events = ring->events();
+        for(int i = 0; i < events.size(); ++i){
+            const TraceEvent& event = events.at(i);
+            out << ",\n{\"ph\":\"X\",\"name\":" << json_string(QString::fromLatin1(event.name))
+                << ",\"pid\":1,\"tid\":" << ring->tid()
+                << ",\"ts\":" << QString::number(event.begin / 1000.0, 'f', 3)
+                << ",\"dur\":" << QString::number(event.duration / 1000.0, 'f', 3) << '}';
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
+
+#endif
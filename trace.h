@@ -0,0 +1,93 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtCore>
+
+#ifdef TEXTEDITOR_TRACE
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 begin;
+    qint64 duration;
+};
+
+class TraceRing
+{
+public:
+    enum { CAPACITY = 1 << 16 };
+
+    TraceRing(int tid, const QString& name) : tid_(tid), name_(name), head_(0) {}
+
+    inline void append(const char *name, qint64 begin, qint64 duration)
+    {
+        quint64 head = head_.load();
+        TraceEvent& event = events_[head & (CAPACITY - 1)];
+        event.name = name;
+        event.begin = begin;
+        event.duration = duration;
+        head_.storeRelease(head + 1);
+    }
+
+    QVector<TraceEvent> events() const;
+    inline int tid() const { return tid_; }
+    inline const QString& name() const { return name_; }
+
+private:
+    int tid_;
+    QString name_;
+    QAtomicInteger<quint64> head_;
+    TraceEvent events_[CAPACITY];
+};
+
+class Tracer
+{
+public:
+    static Tracer& instance();
+    static qint64 now();
+
+    static inline TraceRing *ring()
+    {
+        static thread_local TraceRing *current = Q_NULLPTR;
+        if(!current)
+            current = instance().register_thread();
+        return current;
+    }
+
+    bool writeJson(const QString& fileName) const;
+
+private:
+    Tracer() {}
+
+    TraceRing *register_thread();
+
+    mutable QMutex mutex_;
+    QList<TraceRing*> rings_;
+
+    Q_DISABLE_COPY(Tracer)
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : name_(name), begin_(Tracer::now()) {}
+    ~TraceScope() { Tracer::ring()->append(name_, begin_, Tracer::now() - begin_); }
+
+private:
+    const char *name_;
+    qint64 begin_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_FLUSH(fileName) Tracer::instance().writeJson(fileName)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while(0)
+#define TRACE_FLUSH(fileName) false
+
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#include "trigram.h"
+
+static inline quint32 reduce_char(ushort value)
+{
+    return value < 0x100 ? value : (value ^ (value >> 8)) & 0xFF;
+}
+
+static const uchar *latin1_trigram_table()
+{
+    struct TrigramTable
+    {
+        TrigramTable()
+        {
+            for(int i = 0; i < 256; ++i)
+                values[i] = reduce_char(QChar(static_cast<ushort>(i)).toCaseFolded().unicode());
+        }
+        uchar values[256];
+    };
+    static const TrigramTable table;
+    return table.values;
+}
+
+static inline quint32 trigram_char(QChar value)
+{
+    ushort code = value.unicode();
+    if(code < 0x100)
+        return latin1_trigram_table()[code];
+    return reduce_char(value.toCaseFolded().unicode());
+}
+
+static quint32 next_index_serial()
+{
+    static QAtomicInt serials;
+    return serials.fetchAndAddRelaxed(1) + 1;
+}
+
+TrigramIndex::TrigramIndex()
+{
+    serial_ = next_index_serial();
+    version_ = 0;
+    valid_ = false;
+    postingBytes_ = 0;
+}
+
+bool TrigramIndex::update(const TextSnapshot &text, const Progress &progress)
+{
+    QMutexLocker locker(&mutex_);
+    return refresh(text, progress);
+}
+
+bool TrigramIndex::candidates(const TextSnapshot &text, const SearchQuery &query, QVector<int> &lines)
+{
+    if(!mutex_.tryLock())
+        return false;
+    refresh(text, Progress());
+
+    int n = query.pattern.size();
+    if(query.regex || n < 3){
+        mutex_.unlock();
+        return false;
+    }
+
+    QVector<const QVector<quint32>*> lists;
+    for(int k = 2; k < n; ++k){
+        quint32 key = trigram_char(query.pattern.at(k - 2)) << 16 |
+                      trigram_char(query.pattern.at(k - 1)) << 8 |
+                      trigram_char(query.pattern.at(k));
+        QHash<quint32, QVector<quint32> >::const_iterator it = postings_.constFind(key);
+        if(it == postings_.constEnd()){
+            mutex_.unlock();
+            return true;
+        }
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<quint32> *a, const QVector<quint32> *b){ return a->size() < b->size(); });
+
+    QVector<quint32> chunks = *lists.first();
+    for(int i = 1; i < lists.size() && !chunks.isEmpty(); ++i){
+        if(lists.at(i) == lists.at(i - 1))
+            continue;
+        QVector<quint32> common;
+        std::set_intersection(chunks.constBegin(), chunks.constEnd(),
+                              lists.at(i)->constBegin(), lists.at(i)->constEnd(),
+                              std::back_inserter(common));
+        chunks.swap(common);
+    }
+
+    foreach (quint32 chunk, chunks) {
+        int end = qMin<int>((chunk + 1) << CHUNK_SHIFT, positions_.size());
+        for(int id = chunk << CHUNK_SHIFT; id < end; ++id)
+            if(positions_.at(id) >= 0)
+                lines.append(positions_.at(id));
+    }
+    mutex_.unlock();
+    std::sort(lines.begin(), lines.end());
+    return true;
+}
+
+void TrigramIndex::reset()
+{
+    postings_.clear();
+    positions_.clear();
+    serial_ = next_index_serial();
+    postingBytes_ = 0;
+}
+
+bool TrigramIndex::refresh(const TextSnapshot &text, const Progress &progress)
+{
+    if(valid_ && version_ == text.version())
+        return true;
+
+    valid_ = false;
+    if(positions_.size() > 2 * text.length() + MIN_GARBAGE)
+        reset();
+    positions_.fill(-1);
+
+    quint64 serial = quint64(serial_) << 32;
+    for(int j = 0; j < text.length(); ++j){
+        if(progress && !(j % PROGRESS_STEP) && !progress(j, text.length()))
+            return false;
+
+        const LineNode *node = text.node(j);
+        if((node->stamp & Q_UINT64_C(0xFFFFFFFF00000000)) == serial){
+            int id = int(node->stamp & 0xFFFFFFFF) - 1;
+            if(id < positions_.size() && positions_.at(id) < 0){
+                positions_[id] = j;
+                continue;
+            }
+        }
+        quint32 id = positions_.size();
+        positions_.append(j);
+        node->stamp = serial | (id + 1);
+        add_line(node->line, id);
+    }
+
+    version_ = text.version();
+    valid_ = true;
+    update_memory();
+    ready_.store(1);
+    return true;
+}
+
+void TrigramIndex::add_line(const Line &line, quint32 id)
+{
+    int n = line.size();
+    if(n < 3)
+        return;
+    quint32 chunk = id >> CHUNK_SHIFT;
+    quint32 key = trigram_char(line.valueAt(0)) << 8 | trigram_char(line.valueAt(1));
+    for(int k = 2; k < n; ++k){
+        key = (key << 8 | trigram_char(line.valueAt(k))) & 0xFFFFFF;
+        QVector<quint32>& list = postings_[key];
+        if(list.isEmpty())
+            postingBytes_ += sizeof(quint32) + sizeof(QVector<quint32>) + 4 * sizeof(void*);
+        if(list.isEmpty() || list.last() != chunk){
+            list.append(chunk);
+            postingBytes_ += sizeof(quint32);
+        }
+    }
+}
+
+void TrigramIndex::update_memory()
+{
+    qint64 bytes = postingBytes_ + positions_.capacity() * sizeof(int);
+    memoryKb_.store(int(bytes / 1024));
+}
+
+IndexTask::IndexTask(int id, TrigramIndex *index, const TextSnapshot &text, QObject *parent)
+    : QObject(parent), id_(id), index_(index), text_(text)
+{
+}
+
+void IndexTask::run(const CancelToken &token)
+{
+    int last = -1;
+    bool done = index_->update(text_, [this, &token, &last](int done, int total) -> bool {
+        if(token.isCancelled())
+            return false;
+        int percent = total ? int(qint64(done) * 100 / total) : 100;
+        if(percent != last){
+            last = percent;
+            emit progress(id_, percent);
+        }
+        return true;
+    });
+    if(done)
+        emit indexFinished(id_);
+}
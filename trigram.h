@@ -0,0 +1,65 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <QtCore>
+
+#include <functional>
+
+#include "char.h"
+#include "jobs.h"
+#include "search.h"
+
+class TrigramIndex
+{
+public:
+    typedef std::function<bool (int, int)> Progress;
+
+    TrigramIndex();
+
+    bool update(const TextSnapshot& text, const Progress& progress = Progress());
+    bool candidates(const TextSnapshot& text, const SearchQuery& query, QVector<int>& lines);
+
+    inline bool isReady() const { return ready_.load(); }
+    inline qint64 memoryUsage() const { return qint64(memoryKb_.load()) * 1024; }
+
+private:
+    enum { CHUNK_SHIFT = 6, MIN_GARBAGE = 4096, PROGRESS_STEP = 16384 };
+
+    void reset();
+    bool refresh(const TextSnapshot& text, const Progress& progress);
+    void add_line(const Line& line, quint32 id);
+    void update_memory();
+
+    QMutex mutex_;
+    QHash<quint32, QVector<quint32> > postings_;
+    QVector<int> positions_;
+    quint32 serial_;
+    quint64 version_;
+    bool valid_;
+    qint64 postingBytes_;
+    QAtomicInt memoryKb_;
+    QAtomicInt ready_;
+
+    Q_DISABLE_COPY(TrigramIndex)
+};
+
+class IndexTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    IndexTask(int id, TrigramIndex *index, const TextSnapshot& text, QObject *parent = Q_NULLPTR);
+
+    void run(const CancelToken& token);
+
+signals:
+    void progress(int id, int percent);
+    void indexFinished(int id);
+
+private:
+    int id_;
+    TrigramIndex *index_;
+    TextSnapshot text_;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "undo.h"
+
+qint64 EditDelta::memoryUsage() const
+{
+    qint64 bytes = sizeof(EditDelta) + symbols.capacity() * sizeof(Symbol) + rows.capacity() * sizeof(int);
+    for(int i = 0; i < lines.size(); ++i)
+        bytes += sizeof(LineRef) + lines.at(i)->line.memoryUsage();
+    return bytes;
+}
+
+UndoStack::UndoStack(qint64 budget)
+{
+    budget_ = budget;
+    bytes_ = 0;
+    groupDepth_ = 0;
+    groupOpen_ = false;
+    sealed_ = true;
+}
+
+void UndoStack::setBudget(qint64 bytes)
+{
+    budget_ = bytes;
+    trim();
+}
+
+void UndoStack::beginGroup()
+{
+    if(!groupDepth_++)
+        groupOpen_ = false;
+}
+
+void UndoStack::endGroup()
+{
+    if(groupDepth_ && !--groupDepth_)
+        sealed_ = true;
+}
+
+void UndoStack::record(const EditDelta &delta, QPoint before, QPoint after)
+{
+    clear_redo();
+    qint64 bytes = delta.memoryUsage();
+    if(groupDepth_ && groupOpen_){
+        EditCommand& command = undo_.last();
+        command.deltas.append(delta);
+        command.after = after;
+        command.bytes += bytes;
+        bytes_ += bytes;
+        return;
+    }
+    if(!groupDepth_ && coalesce(delta, before, after))
+        return;
+
+    EditCommand command;
+    command.deltas.append(delta);
+    command.before = before;
+    command.after = after;
+    command.bytes = bytes;
+    undo_.append(command);
+    bytes_ += bytes;
+    groupOpen_ = groupDepth_ > 0;
+    sealed_ = groupDepth_ > 0;
+    trim();
+}
+
+void UndoStack::clear()
+{
+    undo_.clear();
+    redo_.clear();
+    bytes_ = 0;
+    groupOpen_ = false;
+    sealed_ = true;
+}
+
+bool UndoStack::takeUndo(EditCommand &command)
+{
+    if(undo_.isEmpty())
+        return false;
+    command = undo_.takeLast();
+    bytes_ -= command.bytes;
+    sealed_ = true;
+    groupOpen_ = false;
+    return true;
+}
+
+bool UndoStack::takeRedo(EditCommand &command)
+{
+    if(redo_.isEmpty())
+        return false;
+    command = redo_.takeLast();
+    bytes_ -= command.bytes;
+    sealed_ = true;
+    return true;
+}
+
+void UndoStack::pushUndo(const EditCommand &command)
+{
+    undo_.append(command);
+    undo_.last().bytes = 0;
+    foreach (const EditDelta& delta, command.deltas)
+        undo_.last().bytes += delta.memoryUsage();
+    bytes_ += undo_.last().bytes;
+    trim();
+}
+
+void UndoStack::pushRedo(const EditCommand &command)
+{
+    redo_.append(command);
+    redo_.last().bytes = 0;
+    foreach (const EditDelta& delta, command.deltas)
+        redo_.last().bytes += delta.memoryUsage();
+    bytes_ += redo_.last().bytes;
+}
+
+bool UndoStack::coalesce(const EditDelta &delta, QPoint before, QPoint after)
+{
+    if(sealed_ || undo_.isEmpty())
+        return false;
+    EditCommand& top = undo_.last();
+    if(top.deltas.size() != 1 || top.after != before)
+        return false;
+    EditDelta& last = top.deltas.first();
+    if(last.kind != delta.kind || last.y != delta.y)
+        return false;
+
+    qint64 bytes = -last.memoryUsage();
+    if(delta.kind == EditDelta::RemoveSymbols && last.x + last.count == delta.x)
+        last.count += delta.count;
+    else if(delta.kind == EditDelta::InsertSymbols && delta.x + delta.symbols.size() == last.x){
+        last.symbols = delta.symbols + last.symbols;
+        last.x = delta.x;
+    }
+    else
+        return false;
+    bytes += last.memoryUsage();
+    top.after = after;
+    top.bytes += bytes;
+    bytes_ += bytes;
+    trim();
+    return true;
+}
+
+void UndoStack::trim()
+{
+    while(bytes_ > budget_ && undo_.size() > 1)
+        bytes_ -= undo_.takeFirst().bytes;
+    while(bytes_ > budget_ && !redo_.isEmpty())
+        bytes_ -= redo_.takeFirst().bytes;
+}
+
+void UndoStack::clear_redo()
+{
+    foreach (const EditCommand& command, redo_)
+        bytes_ -= command.bytes;
+    redo_.clear();
+}
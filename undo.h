@@ -0,0 +1,92 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <QtCore>
+
+#include "char.h"
+
+struct EditDelta
+{
+    enum Kind { InsertSymbols, RemoveSymbols, SplitLine, JoinLine, ReplaceLines, SwapLines };
+
+    EditDelta() : kind(RemoveSymbols), x(0), y(0), count(0) {}
+    EditDelta(Kind k, int px, int py, int n = 0) : kind(k), x(px), y(py), count(n) {}
+
+    qint64 memoryUsage() const;
+
+    Kind kind;
+    int x;
+    int y;
+    int count;
+    QVector<Symbol> symbols;
+    QVector<int> rows;
+    LineList lines;
+};
+
+struct EditCommand
+{
+    EditCommand() : bytes(0) {}
+
+    QVector<EditDelta> deltas;
+    QPoint before;
+    QPoint after;
+    qint64 bytes;
+};
+
+class UndoStack
+{
+public:
+    enum { DEFAULT_BUDGET = 64 * 1024 * 1024 };
+
+    explicit UndoStack(qint64 budget = DEFAULT_BUDGET);
+
+    inline bool canUndo() const { return !undo_.isEmpty(); }
+    inline bool canRedo() const { return !redo_.isEmpty(); }
+    inline int undoCount() const { return undo_.size(); }
+    inline int redoCount() const { return redo_.size(); }
+
+    inline qint64 budget() const { return budget_; }
+    void setBudget(qint64 bytes);
+    inline qint64 bytes() const { return bytes_; }
+
+    void beginGroup();
+    void endGroup();
+    inline void seal() { sealed_ = true; }
+
+    void record(const EditDelta& delta, QPoint before, QPoint after);
+    void clear();
+
+    bool takeUndo(EditCommand& command);
+    bool takeRedo(EditCommand& command);
+    void pushUndo(const EditCommand& command);
+    void pushRedo(const EditCommand& command);
+
+private:
+    bool coalesce(const EditDelta& delta, QPoint before, QPoint after);
+    void trim();
+    void clear_redo();
+
+    QList<EditCommand> undo_;
+    QList<EditCommand> redo_;
+    qint64 budget_;
+    qint64 bytes_;
+    int groupDepth_;
+    bool groupOpen_;
+    bool sealed_;
+};
+
+// Makes the edits recorded while it is alive one undo step; a null stack
+// leaves them as they are.
+class UndoGroup
+{
+public:
+    explicit UndoGroup(UndoStack *stack) : stack_(stack) { if(stack_) stack_->beginGroup(); }
+    ~UndoGroup() { if(stack_) stack_->endGroup(); }
+
+private:
+    UndoStack *stack_;
+
+    Q_DISABLE_COPY(UndoGroup)
+};
+
+#endif
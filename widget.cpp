@@ -7,17 +7,31 @@ Widget::Widget() :
 
     menu = new Menu(menuComponents, this);
     setMenuBar(menu);
+    StartupProfiler::instance().mark(StartupProfiler::MenuCreated);
 
     editToolBar = new EditToolBar(menuComponents, this);
     addToolBar(editToolBar);
+    StartupProfiler::instance().mark(StartupProfiler::ToolBarCreated);
 
     defaultFont = QFont(editToolBar->getFontType(), editToolBar->getFontSize());
 
     textField = new TextField(defaultFont, this);
+    StartupProfiler::instance().mark(StartupProfiler::TextFieldCreated);
+    inputRecorder = new InputRecorder(this);
     textField->setFocus();
     setCentralWidget(textField);
     textField->setTextEditorView(Qt::white);
 
+    findBar = new FindBar(this);
+    addToolBar(Qt::BottomToolBarArea, findBar);
+    findBar->hide();
+    findEngine = new FindEngine(this);
+    jumpPending = false;
+    jumpForward = true;
+    loading = false;
+
+    createStatusBar();
+
     setCurrentFileName("");
 
     connect(menuComponents->newAction, SIGNAL( triggered() ), SLOT( newFile() ) );
@@ -25,11 +39,16 @@ Widget::Widget() :
     connect(menuComponents->saveAction, SIGNAL( triggered() ), SLOT( save() ) );
     connect(menuComponents->saveAsAction, SIGNAL( triggered() ), SLOT( saveAs() ) );
     connect(menuComponents->exitAction, SIGNAL( triggered() ), SLOT( closeApp() ) );
+    connect(menuComponents->undoAction, SIGNAL( triggered() ), SLOT( undoText() ) );
+    connect(menuComponents->redoAction, SIGNAL( triggered() ), SLOT( redoText() ) );
     connect(menuComponents->cutAction, SIGNAL( triggered() ), SLOT( cutText() ) );
     connect(menuComponents->copyAction, SIGNAL( triggered() ), SLOT( copyText() ) );
     connect(menuComponents->pasteAction, SIGNAL( triggered() ), SLOT( pasteText() ) );
     connect(menuComponents->deleteAction, SIGNAL( triggered() ), SLOT( deleteText() ) );
-    connect(menuComponents->fontTypeMenu, SIGNAL( triggered(QAction*) ), SLOT( changeCurrentFont(QAction*) ) );
+    connect(menuComponents->findAction, SIGNAL( triggered() ), findBar, SLOT( activate() ) );
+    connect(menuComponents->findNextAction, SIGNAL( triggered() ), SLOT( findNext() ) );
+    connect(menuComponents->findPreviousAction, SIGNAL( triggered() ), SLOT( findPrevious() ) );
+    connect(menuComponents, SIGNAL( fontFamilyChosen(QString) ), textField, SLOT( changeCurrentFont(QString) ) );
     connect(menuComponents->fontSizeMenu, SIGNAL( triggered(QAction*) ), SLOT( changeFontSize(QAction*) ) );
 
     connect(editToolBar->getFontBox(), SIGNAL( activated(QString) ), textField, SLOT( changeCurrentFont(QString) ) );
@@ -39,6 +58,24 @@ Widget::Widget() :
 
     connect(textField, SIGNAL( fontChanged(const QFont&) ), editToolBar, SLOT( changeToolBarFonts(const QFont&) ) );
 
+    connect(findBar, SIGNAL( queryChanged() ), SLOT( startSearch() ) );
+    connect(findBar, SIGNAL( findNext() ), SLOT( findNext() ) );
+    connect(findBar, SIGNAL( findPrevious() ), SLOT( findPrevious() ) );
+    connect(findBar, SIGNAL( replaceAll() ), SLOT( replaceAll() ) );
+    connect(findEngine, SIGNAL( matchesFound(int) ), SLOT( searchProgress(int) ) );
+    connect(findEngine, SIGNAL( finished(int) ), SLOT( searchFinished(int) ) );
+    connect(menuComponents->searchIndexAction, SIGNAL( toggled(bool) ), SLOT( setSearchIndex(bool) ) );
+    connect(findEngine, SIGNAL( indexProgress(int) ), SLOT( indexProgress(int) ) );
+    connect(findEngine, SIGNAL( indexReady() ), SLOT( indexReady() ) );
+    connect(menuComponents->latencyHudAction, SIGNAL( toggled(bool) ), SLOT( setLatencyHud(bool) ) );
+    connect(menuComponents->dumpLatencyAction, SIGNAL( triggered() ), SLOT( dumpLatency() ) );
+    connect(menuComponents->recordInputAction, SIGNAL( toggled(bool) ), SLOT( recordInput(bool) ) );
+    connect(menuComponents->memoryUsageAction, SIGNAL( toggled(bool) ), SLOT( setMemoryUsage(bool) ) );
+    if(menuComponents->saveTraceAction)
+        connect(menuComponents->saveTraceAction, SIGNAL( triggered() ), SLOT( saveTrace() ) );
+    if(menuComponents->saveAllocProfileAction)
+        connect(menuComponents->saveAllocProfileAction, SIGNAL( triggered() ), SLOT( saveAllocProfile() ) );
+
     setWindowTitle(tr("TextEditor"));
 
     textField->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
@@ -51,7 +88,27 @@ Widget::Widget() :
 
 Widget::~Widget()
 {
+    loadJob.cancel();
+    saveJob.wait();
+}
 
+void Widget::createStatusBar()
+{
+    indexLabel = new QLabel(this);
+    indexProgressBar = new QProgressBar(this);
+    indexProgressBar->setRange(0, 100);
+    indexProgressBar->setMaximumWidth(150);
+    indexProgressBar->hide();
+
+    memoryLabel = new QLabel(this);
+    memoryLabel->hide();
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(MEMORY_INTERVAL);
+    connect(memoryTimer, SIGNAL( timeout() ), SLOT( updateMemoryUsage() ) );
+
+    statusBar()->addPermanentWidget(indexProgressBar);
+    statusBar()->addPermanentWidget(indexLabel);
+    statusBar()->addPermanentWidget(memoryLabel);
 }
 
 void Widget::contextMenuEvent(QContextMenuEvent* mouse_pointer)
@@ -70,7 +127,7 @@ void Widget::closeEvent(QCloseEvent * closeEvent)
 
 bool Widget::agreedToContinue()
  {
-     if (!textEdit.document()->isModified())
+     if (waitForSave() && !textEdit.document()->isModified())
          return true;
      QMessageBox::StandardButton answer = QMessageBox::warning(this,
                        tr("The document has been modified"),
@@ -78,7 +135,7 @@ bool Widget::agreedToContinue()
                        QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
 
      if (answer == QMessageBox::Save)
-         return save();
+         return save() && waitForSave();
      else if (answer == QMessageBox::Cancel)
          return false;
      return true;
@@ -87,6 +144,8 @@ bool Widget::agreedToContinue()
 void Widget::newFile()
 {
     if(agreedToContinue()){
+        loadJob.cancel();
+        loading = false;
         textField->clear();
         setCurrentFileName("");
     }
@@ -97,7 +156,7 @@ void Widget::open()
     if(agreedToContinue()){
         QString openFileName = QFileDialog::getOpenFileName(this,
                                                 tr("Open file"), "/media/file",
-                                                tr("Text files (*.txt);;Xml files (*.xml)"));
+                                                tr("Text files (*.txt);;Xml files (*.xml);;All files (*)"));
         if(!openFileName.isEmpty())
             loadFile(openFileName);
 
@@ -119,46 +178,126 @@ bool Widget::saveAs()
                                                 tr("Text files (*.txt);;Xml files (*.xml)"));
     if(fileName.isEmpty())
         return false;
-    if(!fileName.endsWith(".txt") && !fileName.endsWith(".xml"))
+    if(QFileInfo(fileName).suffix().isEmpty())
         fileName += ".xml";
     return saveFile(fileName);
 }
 
 bool Widget::loadFile(const QString &fileName)
 {
-    try{
-        textField->setText(fileRecorder.read(fileName, defaultFont));
+    loadJob.cancel();
+
+    // Only the first screen is decoded before the document is shown; the
+    // rest of the file is read in chunks and appended behind it.
+    int firstScreen = qMax<int>(FIRST_SCREEN_LINES,
+                                textField->viewport()->height() / QFontMetrics(defaultFont).height() + 1);
+    QSharedPointer<FileRecord> record(new FileRecord);
+    QSharedPointer<QScopedPointer<Text> > result(new QScopedPointer<Text>);
+    QFont font = defaultFont;
+    QThread *gui = thread();
+    loading = true;
+    loadJob = JobPool::instance().submit(JobPool::Interactive, [record, result, fileName, font, firstScreen, gui](const CancelToken&) {
+        try{
+            record->open(fileName, font);
+            result->reset(record->readLines(firstScreen));
+            (*result)->moveToThread(gui);
+        }
+        catch(FileOpenException &)
+        {
+        }
+    }, this, [this, record, result, fileName]() {
+        if(result->isNull()){
+            loading = false;
+            statusBar()->showMessage(tr("Cannot open %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+            StartupProfiler::instance().setFileExpected(false);
+            return;
+        }
+        textField->setText(result->data());
+        result->reset();
+        StartupProfiler::instance().mark(StartupProfiler::FileLoaded);
 
         textField->setCurrentPos(QPoint(0, 0));
         setCurrentFileName(fileName);
-    }
-    catch(FileOpenException &)
-    {
-        return false;
-    }
+        loadRemainder(record);
+    });
+    statusBar()->showMessage(tr("Loading %1...").arg(QFileInfo(fileName).fileName()));
 
     return true;
 }
 
-bool Widget::saveFile(const QString &fileName)
+void Widget::loadRemainder(const QSharedPointer<FileRecord> &record)
 {
-    try{
-        fileRecorder.write(textField->getText(), fileName);
-        setCurrentFileName(fileName);
+    if(record->atEnd()){
+        loading = false;
+        findEngine->updateIndex(textField->getText()->snapshot());
+        statusBar()->clearMessage();
+        return;
     }
-    catch(FileOpenException &)
-    {
+
+    QSharedPointer<TextSnapshot> chunk(new TextSnapshot);
+    ArenaRef arena = textField->getText()->arena();
+    loadJob = JobPool::instance().submit(JobPool::Visible, [record, chunk, arena](const CancelToken&) {
+        QScopedPointer<Text> text(record->readLines(LOAD_CHUNK_LINES, arena));
+        *chunk = text->snapshot();
+    }, this, [this, record, chunk]() {
+        textField->appendText(*chunk);
+        loadRemainder(record);
+    });
+}
+
+bool Widget::saveFile(const QString &fileName)
+{
+    if(loading){
+        statusBar()->showMessage(tr("%1 is still loading").arg(QFileInfo(currentFileName).fileName()), STATUS_TIMEOUT);
         return false;
     }
+    saveJob.wait();
+
+    TextSnapshot text = textField->getText()->snapshot();
+    QSharedPointer<bool> saved(new bool(false));
+    saveResult = saved;
+    saveJob = JobPool::instance().submit(JobPool::Interactive, [text, fileName, saved](const CancelToken&) {
+        FileRecord record;
+        try{
+            *saved = record.write(text, fileName);
+        }
+        catch(FileOpenException &)
+        {
+        }
+    }, this, [this, fileName, saved]() {
+        QString name = QFileInfo(fileName).fileName();
+        if(*saved)
+            setCurrentFileName(fileName);
+        statusBar()->showMessage(*saved ? tr("Saved %1").arg(name) : tr("Cannot save %1").arg(name),
+                                 STATUS_TIMEOUT);
+    });
 
     return true;
 }
 
+// Blocks until the last save is on disk. The document is only renamed once
+// the write succeeds, so anything about to discard it must check this first.
+bool Widget::waitForSave()
+{
+    saveJob.wait();
+    return saveResult.isNull() || *saveResult;
+}
+
 void Widget::closeApp()
 {
     close();
 }
 
+void Widget::undoText()
+{
+    textField->undo();
+}
+
+void Widget::redoText()
+{
+    textField->redo();
+}
+
 void Widget::cutText()
 {
     textField->cut();
@@ -179,14 +318,189 @@ void Widget::deleteText()
      textField->clear();
 }
 
-void Widget::changeFontSize(QAction* action)
+void Widget::startSearch()
 {
-    textField->changeCurrentFontSize(action->text());
+    jumpPending = true;
+    findEngine->find(textField->getText()->snapshot(), findBar->query());
+    if(!findEngine->isValid())
+        findBar->setInvalid();
+}
+
+void Widget::findNext()
+{
+    jumpToMatch(true);
+}
+
+void Widget::findPrevious()
+{
+    jumpToMatch(false);
+}
+
+void Widget::replaceAll()
+{
+    SearchQuery query = findBar->query();
+    const Text *text = textField->getText();
+    SearchMatches matches;
+    if(!findEngine->isRunning() && findEngine->query() == query && findEngine->version() == text->version())
+        matches = findEngine->matches();
+    else
+        matches = FindEngine::findAll(text->snapshot(), query);
+
+    int count = textField->replaceAll(matches, findBar->replacement());
+    findEngine->cancel();
+    findBar->setReplaced(count);
 }
 
-void Widget::changeCurrentFont(QAction* action)
+void Widget::searchProgress(int count)
 {
-    textField->changeCurrentFont(action->text());
+    findBar->setMatchCount(count, false);
+    if(jumpPending){
+        jumpPending = false;
+        jumpToMatch(jumpForward, true);
+    }
+}
+
+void Widget::searchFinished(int count)
+{
+    findBar->setMatchCount(count, true);
+    jumpPending = false;
+    if(findEngine->isIndexEnabled() && indexProgressBar->isHidden())
+        indexReady();
+}
+
+void Widget::setSearchIndex(bool enabled)
+{
+    findEngine->setIndexEnabled(enabled);
+    if(enabled)
+        findEngine->updateIndex(textField->getText()->snapshot());
+    else{
+        indexProgressBar->hide();
+        indexLabel->clear();
+    }
+}
+
+void Widget::indexProgress(int percent)
+{
+    indexProgressBar->setValue(percent);
+    indexProgressBar->show();
+    indexLabel->setText(tr("Indexing..."));
+}
+
+void Widget::indexReady()
+{
+    indexProgressBar->hide();
+    indexLabel->setText(tr("Index: %1 MB").arg(findEngine->indexMemory() / (1024.0 * 1024.0), 0, 'f', 1));
+}
+
+void Widget::setLatencyHud(bool visible)
+{
+    textField->setLatencyHudVisible(visible);
+}
+
+void Widget::dumpLatency()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                tr("Dump latency"), "latency.csv",
+                                                tr("CSV files (*.csv);;All files (*)"));
+    if(fileName.isEmpty())
+        return;
+    if(LatencyMonitor::instance().dump(fileName))
+        statusBar()->showMessage(tr("Latency written to %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+    else
+        statusBar()->showMessage(tr("Cannot write %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+}
+
+void Widget::recordInput(bool enabled)
+{
+    if(enabled){
+        inputRecorder->start(textField);
+        statusBar()->showMessage(tr("Recording input"), STATUS_TIMEOUT);
+        return;
+    }
+    InputTrace trace = inputRecorder->stop();
+    if(trace.isEmpty())
+        return;
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                tr("Save input trace"), "input.trace",
+                                                tr("Input traces (*.trace);;All files (*)"));
+    if(fileName.isEmpty())
+        return;
+    if(trace.save(fileName))
+        statusBar()->showMessage(tr("%1 events written to %2").arg(trace.size())
+                                 .arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+    else
+        statusBar()->showMessage(tr("Cannot write %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+}
+
+void Widget::setMemoryUsage(bool visible)
+{
+    memoryLabel->setVisible(visible);
+    if(visible){
+        updateMemoryUsage();
+        memoryTimer->start();
+    }
+    else
+        memoryTimer->stop();
+}
+
+void Widget::updateMemoryUsage()
+{
+    MemoryUsage usage = textField->memoryUsage();
+    usage.add(MemoryUsage::SearchIndex, findEngine->indexMemory());
+    memoryLabel->setText(usage.summary());
+    memoryLabel->setToolTip(usage.details());
+}
+
+void Widget::saveTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                tr("Save trace"), "trace.json",
+                                                tr("Chrome trace (*.json);;All files (*)"));
+    if(fileName.isEmpty())
+        return;
+    if(TRACE_FLUSH(fileName))
+        statusBar()->showMessage(tr("Trace written to %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+    else
+        statusBar()->showMessage(tr("Cannot write %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+}
+
+void Widget::saveAllocProfile()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                tr("Save allocation profile"), "alloc.txt",
+                                                tr("Text files (*.txt);;All files (*)"));
+    if(fileName.isEmpty())
+        return;
+    if(ALLOC_REPORT(fileName))
+        statusBar()->showMessage(tr("Allocation profile written to %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+    else
+        statusBar()->showMessage(tr("Cannot write %1").arg(QFileInfo(fileName).fileName()), STATUS_TIMEOUT);
+}
+
+void Widget::jumpToMatch(bool forward, bool incremental)
+{
+    if(findBar->query().isEmpty()){
+        findBar->activate();
+        return;
+    }
+    if(findEngine->version() != textField->getText()->version()){
+        jumpForward = forward;
+        startSearch();
+        return;
+    }
+
+    QPoint from = forward && !incremental ? textField->getCurrentPos() :
+                                            textField->getSelectionStart();
+    int i = forward ? findEngine->next(from) : findEngine->previous(from);
+    if(i < 0)
+        return;
+    const SearchMatch& match = findEngine->matches().at(i);
+    textField->select(match.begin(), match.end());
+}
+
+void Widget::changeFontSize(QAction* action)
+{
+    textField->changeCurrentFontSize(action->text());
 }
 
 void Widget::setBoldText()
@@ -206,6 +520,7 @@ void Widget::setItalicText()
 void Widget::setCurrentFileName(const QString &fileName)
 {
     currentFileName = fileName;
+    textField->setSyntax(SyntaxDefinition::forFile(fileName));
 
     QString shownName;
     if(currentFileName.isEmpty())
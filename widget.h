@@ -7,6 +7,10 @@
 #include "toolbar.h"
 #include "field.h"
 #include "filerecord.h"
+#include "findbar.h"
+#include "jobs.h"
+#include "inputtrace.h"
+#include "startup.h"
 
 class Widget : public QMainWindow
 {
@@ -17,6 +21,8 @@ public:
     explicit Widget();
     ~Widget();
 
+    bool loadFile(const QString &openFileName);
+
 public slots:
     void newFile();
     void open();
@@ -25,12 +31,31 @@ public slots:
 
     void closeApp();
 
+    void undoText();
+    void redoText();
     void cutText();
     void copyText();
     void pasteText();
     void deleteText();
 
-    void changeCurrentFont(QAction*);
+    void startSearch();
+    void findNext();
+    void findPrevious();
+    void replaceAll();
+    void searchProgress(int count);
+    void searchFinished(int count);
+    void setSearchIndex(bool enabled);
+    void indexProgress(int percent);
+    void indexReady();
+
+    void setLatencyHud(bool visible);
+    void dumpLatency();
+    void recordInput(bool enabled);
+    void setMemoryUsage(bool visible);
+    void updateMemoryUsage();
+    void saveTrace();
+    void saveAllocProfile();
+
     void changeFontSize(QAction*);
     void setBoldText();
     void setItalicText();
@@ -42,19 +67,38 @@ protected:
     void createStatusBar();
 
 private:
-    bool loadFile(const QString &openFileName);
+    enum { STATUS_TIMEOUT = 3000, MEMORY_INTERVAL = 1000 };
+    enum { FIRST_SCREEN_LINES = 64, LOAD_CHUNK_LINES = 65536 };
+
+    void loadRemainder(const QSharedPointer<FileRecord> &record);
     bool saveFile(const QString &openFileName);
+    bool waitForSave();
 
     bool agreedToContinue();
     void setCurrentFileName(const QString &fileName);
+    void jumpToMatch(bool forward, bool incremental = false);
 
     MenuComponents *menuComponents;
     Menu *menu;
     EditToolBar *editToolBar;
+    FindBar *findBar;
+    FindEngine *findEngine;
+    bool jumpPending;
+    bool jumpForward;
+
+    QLabel *indexLabel;
+    QProgressBar *indexProgressBar;
+    QLabel *memoryLabel;
+    QTimer *memoryTimer;
 
     TextField *textField;
+    InputRecorder *inputRecorder;
 
     FileRecord fileRecorder;
+    JobHandle loadJob;
+    bool loading;
+    JobHandle saveJob;
+    QSharedPointer<bool> saveResult;
 
     QFont defaultFont;
 